@@ -0,0 +1,70 @@
+/*
+    Small-message throughput, publishing several subjects per cycle one at a time or as a batch.
+    One at a time, each publish is written out and flushed before the next, as a node that loops between them would.
+    Batched, the cycle's publishes go to each transport in one send_batch() call and the serial port is flushed once.
+*/
+#include "bench.h"
+#include "transports/udp.h"
+
+static const int messages = 200000;
+
+// writes counts port flushes for serial, and datagrams for udp
+static void run(const char* name, UAVNode& node, std::function<void()> drain, std::function<uint64_t()> wire, const char* unit, std::function<uint64_t()> writes) {
+    uint8_t payload[8] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+    int sizes[] = { 1, 4, 8 };
+    for(int per_cycle : sizes) {
+        for(int batched=0; batched<2; batched++) {
+            if( (per_cycle==1) && batched ) continue;
+            int cycles = messages / per_cycle;
+            uint64_t w = wire();
+            uint64_t f = writes();
+            uint64_t ns = bench_best(1, [&]() {
+                for(int c=0; c<cycles; c++) {
+                    if(batched) {
+                        node.publish_begin();
+                        for(int i=0; i<per_cycle; i++) node.publish(1000+i, 0x1234, UAVTransfer::PriorityNominal, payload, sizeof(payload));
+                        node.publish_end();
+                        drain();
+                    } else {
+                        for(int i=0; i<per_cycle; i++) {
+                            node.publish(1000+i, 0x1234, UAVTransfer::PriorityNominal, payload, sizeof(payload));
+                            drain();
+                        }
+                    }
+                }
+            });
+            int sent = cycles * per_cycle;
+            printf("  %-7s %2d per cycle  %-9s %6.2f M messages/s  %5.1f bytes per message  %4.2f %s per cycle\n",
+                name, per_cycle, batched ? "batched" : "one by one", sent*1000.0/ns,
+                (double)(wire()-w)/sent, (double)(writes()-f)/cycles, unit);
+        }
+    }
+}
+
+int main() {
+    // the nodes go first, so the transports are gone before the transfer pools they hold on to
+    UAVNode serial_node, udp_node;
+    unsigned long t = 0;
+    std::deque<uint8_t> rx, tx;
+    BenchPipe pipe(&rx, &tx);
+    SerialTransport serial(pipe);
+    serial_node.local_node_id = 10;
+    serial_node.add(&serial);
+    PortUDPTransport udp(16384);
+    udp_node.local_node_id = 10;
+    udp_node.add(&udp);
+
+    printf("8 byte messages, %d per run\n", messages);
+    run("serial", serial_node, [&]() { serial_node.loop(++t, 1); tx.clear(); }, [&]() { return pipe.written; }, "flushes", [&]() { return pipe.flushes; });
+    run("udp", udp_node, []() { }, []() { return host_lwip.bytes; }, "datagrams", []() { return host_lwip.datagrams; });
+    // nothing dropped on the way
+    uint32_t drops = 0;
+    for(int p=0; p<UV_SERIAL_PRIORITIES; p++) drops += serial.drops[p];
+    serial_node.remove(&serial);
+    udp_node.remove(&udp);
+    if(drops>0) {
+        printf("serial transport dropped %u transfers\n", drops);
+        return 1;
+    }
+    return 0;
+}
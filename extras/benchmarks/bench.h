@@ -0,0 +1,108 @@
+#ifndef LIBUAVESP_BENCH_H_INCLUDED
+#define LIBUAVESP_BENCH_H_INCLUDED
+
+/*
+    Shared bits for the host benchmarks: a nanosecond clock, a best-of-n timer, and a port pair for wiring nodes together.
+    Build and run them with `make bench` in extras.
+*/
+#include <Arduino.h>
+#include <time.h>
+#include <deque>
+#include <vector>
+#include "node.h"
+#include "transports/serial.h"
+
+inline uint64_t bench_ns() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec*1000000000ULL + ts.tv_nsec;
+}
+
+// fastest of several runs of fn, in nanoseconds. the fastest is the one least disturbed by the rest of the machine.
+template <typename F>
+uint64_t bench_best(int runs, F fn) {
+    uint64_t best = ~0ULL;
+    for(int i=0; i<runs; i++) {
+        uint64_t t = bench_ns();
+        fn();
+        t = bench_ns() - t;
+        if(t<best) best = t;
+    }
+    return best;
+}
+
+// stops the optimiser throwing away a result
+template <typename T>
+inline void bench_keep(const T& value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+// one end of an unbounded in-memory link. the other end reads what this one writes, and the reverse.
+class BenchPipe : public UAVSerialPort {
+    public:
+        std::deque<uint8_t>* in;
+        std::deque<uint8_t>* out;
+        uint64_t written = 0;
+        uint64_t flushes = 0;
+        BenchPipe(std::deque<uint8_t>* i, std::deque<uint8_t>* o) : in(i), out(o) { }
+        void read(uint8_t* buffer, int count) override {
+            std::copy(in->begin(), in->begin()+count, buffer);
+            in->erase(in->begin(), in->begin()+count);
+        }
+        void write(uint8_t* buffer, int count) override { out->insert(out->end(), buffer, buffer+count); written += count; }
+        void flush() override { flushes++; }
+        int readCount() override { return in->size(); }
+        int writeCount() override { return 1<<16; }
+};
+
+// a transport that says it sent everything, so requests wait for their response or timeout
+class BenchSink : public UAVTransport {
+    public:
+        UAVSendStatus send(UAVTransfer* transfer) override { transfer->sent(); return UV_SEND_SENT; }
+};
+
+// two nodes on a point-to-point serial link
+class BenchLink {
+    public:
+        std::deque<uint8_t> ab, ba;
+        BenchPipe pa{&ba, &ab};
+        BenchPipe pb{&ab, &ba};
+        SerialTransport ta{pa};
+        SerialTransport tb{pb};
+        UAVNode a, b;
+        BenchLink(UAVNodeID ida = 10, UAVNodeID idb = 20) {
+            a.local_node_id = ida;
+            b.local_node_id = idb;
+            a.add(&ta);
+            b.add(&tb);
+        }
+        ~BenchLink() {
+            a.remove(&ta);
+            b.remove(&tb);
+        }
+        void pump(unsigned long t, int rounds = 4) {
+            for(int i=0; i<rounds; i++) {
+                a.loop(t, 1);
+                b.loop(t, 1);
+            }
+        }
+};
+
+// the byte stream a serial transport on node 10 writes for count transfers, sent one at a time by fn(node, i)
+template <typename F>
+std::vector<uint8_t> bench_capture(int count, F fn) {
+    UAVNode node;
+    std::deque<uint8_t> in, out;
+    BenchPipe pipe(&in, &out);
+    SerialTransport transport(pipe);
+    node.local_node_id = 10;
+    node.add(&transport);
+    for(int i=0; i<count; i++) {
+        fn(node, i);
+        node.loop(i, 1);
+    }
+    node.remove(&transport);
+    return std::vector<uint8_t>(out.begin(), out.end());
+}
+
+#endif
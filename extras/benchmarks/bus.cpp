@@ -0,0 +1,115 @@
+/*
+    Load test: 100 nodes sharing one simulated 115200 baud serial segment with 200 us latency.
+    Every node publishes a small status message once a second and subscribes to everyone else's,
+    first on a clean bus, where all of them must arrive, then with byte errors, where the CRCs must catch them.
+    Then an overload, with every node publishing 100 byte messages at two priorities five times a second,
+    with large and small port buffers. That offers the bus about six times the high priority traffic it can carry,
+    so the high priority ones should fill most of its capacity, ahead of the low ones.
+*/
+#include "bench.h"
+#include "transports/simbus.h"
+
+static const char dtname_status[] PROGMEM = "bench.bus.Status.1.0";
+static const char dtname_high[] PROGMEM = "bench.bus.High.1.0";
+static const char dtname_low[] PROGMEM = "bench.bus.Low.1.0";
+static const int nodes = 100;
+
+class Segment {
+    public:
+        SimulatedSerialBus bus;
+        std::vector<UAVNode*> node;
+        std::vector<SerialTransport*> transport;
+        Segment(uint32_t error_ppm, int buffer_size) : bus(115200, 200, error_ppm, buffer_size) {
+            for(int i=0; i<nodes; i++) {
+                UAVNode* n = new UAVNode();
+                n->local_node_id = 100 + i;
+                SerialTransport* t = new SerialTransport(*bus.connect());
+                n->add(t);
+                node.push_back(n);
+                transport.push_back(t);
+            }
+        }
+        ~Segment() {
+            // transports go first, they hold references to the nodes' transfers
+            for(int i=0; i<nodes; i++) {
+                node[i]->remove(transport[i]);
+                delete transport[i];
+                delete node[i];
+            }
+        }
+        // one simulated millisecond
+        void step() {
+            bus.advance(1000);
+            for(UAVNode* n : node) n->loop(bus.millis(), 1);
+        }
+        uint32_t crc_errors() {
+            uint32_t count = 0;
+            for(SerialTransport* t : transport) count += t->crc_errors;
+            return count;
+        }
+};
+
+static bool status(uint32_t error_ppm, int seconds) {
+    Segment s(error_ppm, UV_SIMBUS_BUFFER_SIZE);
+    UAVDatatypeHash datatype = UAVNode::datatypehash_P(dtname_status);
+    uint32_t delivered = 0;
+    for(UAVNode* n : s.node) n->subscribe(1000, dtname_status, [&delivered](UAVNodeID node_id, UAVInStream& in) { delivered++; });
+    uint8_t payload[7] = { 0 };
+    uint64_t ns = bench_ns();
+    for(int ms=0; ms<(seconds+1)*1000; ms++) {
+        // each node gets its own 10 ms slot in the second
+        if( (ms<seconds*1000) && ((ms%1000)%10==0) ) {
+            s.node[(ms%1000)/10]->publish(1000, datatype, UAVTransfer::PriorityNominal, payload, sizeof(payload));
+        }
+        s.step();
+    }
+    ns = bench_ns() - ns;
+    uint32_t sent = nodes * (nodes-1) * seconds;
+    printf("  %3u ppm byte errors  %6u of %6u delivered  bus %2.0f%% busy  %3llu bytes corrupted  %4u crc rejections  %5.2f s for %d simulated\n",
+        error_ppm, delivered, sent, 100.0*s.bus.busy_us/s.bus.now_us, (unsigned long long)s.bus.bytes_corrupted, s.crc_errors(), ns/1e9, seconds+1);
+    // a clean bus delivers everything. with errors, a corrupted byte can only take out the frame it landed in,
+    // or two if it hit the delimiter between them, at every receiver.
+    if(error_ppm==0) return delivered==sent;
+    return (s.bus.bytes_corrupted>0) && (delivered<sent) && (delivered + 2*s.bus.bytes_corrupted*(nodes-1) >= sent);
+}
+
+static bool overload(int buffer_size, int seconds) {
+    Segment s(0, buffer_size);
+    UAVDatatypeHash high_dt = UAVNode::datatypehash_P(dtname_high);
+    UAVDatatypeHash low_dt = UAVNode::datatypehash_P(dtname_low);
+    uint32_t high = 0, low = 0;
+    for(UAVNode* n : s.node) {
+        n->subscribe(2000, dtname_high, [&high](UAVNodeID node_id, UAVInStream& in) { high++; });
+        n->subscribe(2001, dtname_low, [&low](UAVNodeID node_id, UAVInStream& in) { low++; });
+    }
+    uint8_t payload[100] = { 0 };
+    for(int ms=0; ms<(seconds+1)*1000; ms++) {
+        // each node gets its own 2 ms slot in every 200 ms
+        if( (ms<seconds*1000) && ((ms%200)%2==0) ) {
+            UAVNode* n = s.node[(ms%200)/2];
+            n->publish(2000, high_dt, UAVTransfer::PriorityImmediate, payload, sizeof(payload));
+            n->publish(2001, low_dt, UAVTransfer::PrioritySlow, payload, sizeof(payload));
+        }
+        s.step();
+    }
+    uint32_t sent = nodes * (nodes-1) * seconds * 5;
+    // the offered load is several times what the segment carries. a 100 byte message is at least a header, crc and
+    // delimiter more on the wire, so the bus can't deliver more than this many of anything, high priority or not.
+    uint32_t frame_bytes = sizeof(payload) + UV_SERIAL_MIN_FRAME_SIZE + 1;
+    uint32_t capacity = (uint64_t)(seconds+1) * 115200 / 10 / frame_bytes * (nodes-1);
+    printf("  %4d byte port buffers  %6u of %6u high priority delivered, %6u low priority, %6u at most on this bus\n",
+        buffer_size, high, sent, low, capacity);
+    // the high priority messages take most of what the bus can carry
+    return (high > low) && (high <= capacity) && (high > capacity/2);
+}
+
+int main() {
+    bool ok = true;
+    printf("%d nodes on a 115200 baud segment, a 7 byte status message from each once a second\n", nodes);
+    ok &= status(0, 10);
+    ok &= status(300, 10);
+    printf("%d nodes each publishing 100 bytes at priority Immediate and Slow, five times a second for 30 s\n", nodes);
+    ok &= overload(1024, 30);
+    ok &= overload(128, 30);
+    return ok ? 0 : 1;
+}
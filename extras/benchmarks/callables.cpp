@@ -0,0 +1,78 @@
+/*
+    Callback dispatch: std::function against the node's inline UAVCallable, for the two hot cases.
+    A reply closure like the one transfer_receive builds for every request, capturing four words, built and called.
+    A listener fetched from a table and called, copied out the way the old std::map dispatch did, or called in place.
+    Heap allocations are counted by replacing the global operator new.
+*/
+#include "bench.h"
+#include <functional>
+#include <new>
+
+static uint64_t allocations = 0;
+void* operator new(size_t size) {
+    allocations++;
+    void* p = malloc(size);
+    if(p==nullptr) throw std::bad_alloc();
+    return p;
+}
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+static const int calls = 10000000;
+static uint64_t sink = 0;
+
+template <typename Reply>
+static void reply_case(const char* name) {
+    UAVTransfer transfer;
+    transfer.remote_node_id = 7;
+    uint8_t buffer[8];
+    UAVOutStream out(buffer, sizeof(buffer));
+    void* port = &transfer;
+    uint64_t before = allocations;
+    uint64_t ns = bench_best(5, [&]() {
+        for(int i=0; i<calls; i++) {
+            bool reply_called = false;
+            UAVTransfer* t = &transfer;
+            Reply reply = [t,port,&out,&reply_called](UAVOutStream& o)->void {
+                reply_called = true;
+                sink += t->remote_node_id + (uintptr_t)port + o.output_index;
+            };
+            reply(out);
+            bench_keep(reply_called);
+        }
+    });
+    printf("  reply closure, %-13s %6.2f ns per build and call  %5.2f allocations per call\n",
+        name, (double)ns/calls, (double)(allocations-before)/(5.0*calls));
+}
+
+int main() {
+    printf("build and call\n");
+    reply_case<std::function<void(UAVOutStream&)>>("std::function");
+    reply_case<UAVPortReply>("UAVCallable");
+    // listeners: copy out, then call, as the std::map dispatch did, against calling in place
+    printf("fetch and call a listener\n");
+    uint8_t payload[8] = { 0 };
+    UAVInStream in(payload, sizeof(payload));
+    std::function<void(UAVNodeID, UAVInStream&)> fn_listener[4];
+    UAVPortListener inline_listener[4];
+    for(int k=0; k<4; k++) {
+        uint64_t a = k, b = k*3, c = k*5;
+        fn_listener[k] = [a,b,c](UAVNodeID src, UAVInStream& in) { sink += a + b + c + src; };
+        inline_listener[k] = [a,b,c](UAVNodeID src, UAVInStream& in) { sink += a + b + c + src; };
+    }
+    uint64_t before = allocations;
+    uint64_t ns = bench_best(5, [&]() {
+        for(int i=0; i<calls; i++) {
+            auto fn = fn_listener[i&3];
+            fn(5, in);
+        }
+    });
+    printf("  std::function copied  %6.2f ns per call  %5.2f allocations per call\n", (double)ns/calls, (double)(allocations-before)/(5.0*calls));
+    before = allocations;
+    ns = bench_best(5, [&]() {
+        for(int i=0; i<calls; i++) inline_listener[i&3](5, in);
+    });
+    printf("  UAVCallable in place  %6.2f ns per call  %5.2f allocations per call\n", (double)ns/calls, (double)(allocations-before)/(5.0*calls));
+    bench_keep(sink);
+    return 0;
+}
@@ -0,0 +1,72 @@
+/*
+    What capturing a serial link costs, and how fast the capture decodes.
+    Node 10 publishes messages of 8 to 256 bytes to node 20 over a serial link, with and without a CaptureSerialPort
+    wrapped around node 10's end. Then the capture is run through a CaptureDecoder, which must find every transfer.
+*/
+#include "bench.h"
+#include "transports/capture.h"
+
+static const char dtname_blob[] PROGMEM = "bench.capture.Blob.1.0";
+static const int count = 20000;
+static uint32_t decoded;
+
+static bool run(int size) {
+    UAVDatatypeHash datatype = UAVNode::datatypehash_P(dtname_blob);
+    uint8_t payload[256] = { 0 };
+    uint64_t plain, captured, decode;
+    uint32_t delivered = 0;
+    std::vector<uint8_t> stream;
+    {
+        BenchLink link;
+        link.b.subscribe(3000, dtname_blob, [&delivered](UAVNodeID node_id, UAVInStream& in) { delivered++; });
+        plain = bench_best(3, [&]() {
+            for(int i=0; i<count; i++) {
+                link.a.publish(3000, datatype, UAVTransfer::PriorityNominal, payload, size);
+                link.pump(i, 1);
+            }
+        });
+    }
+    {
+        UAVNode a, b;
+        std::deque<uint8_t> ab, ba;
+        BenchPipe pa(&ba, &ab), pb(&ab, &ba);
+        // big enough to hold every run without losing any
+        CaptureSerialPort capture(&pa, false, 3 * count * (size + 64));
+        SerialTransport ta(capture);
+        SerialTransport tb(pb);
+        a.local_node_id = 10;
+        b.local_node_id = 20;
+        a.add(&ta);
+        b.add(&tb);
+        captured = bench_best(3, [&]() {
+            for(int i=0; i<count; i++) {
+                a.publish(3000, datatype, UAVTransfer::PriorityNominal, payload, size);
+                a.loop(i, 1);
+                b.loop(i, 1);
+            }
+        });
+        stream.resize(capture.captureCount());
+        capture.readCapture(stream.data(), stream.size());
+        if(capture.lost!=0) printf("  capture lost %u bytes\n", capture.lost);
+        a.remove(&ta);
+        b.remove(&tb);
+    }
+    bool valid = true;
+    decode = bench_best(3, [&]() {
+        CaptureDecoder decoder;
+        decoder.node.on_receive = [](UAVTransfer* t) { decoded++; };
+        decoded = 0;
+        valid = decoder.decode(stream.data(), stream.size());
+    });
+    printf("  %3d byte payloads  %6.0f ns per publish plain  %6.0f ns captured (%+5.1f%%)  %6.1f MB of capture decoded at %6.1f MB/s  %6u of %6u transfers\n",
+        size, (double)plain/count, (double)captured/count, 100.0*((double)captured-plain)/plain,
+        stream.size()/1e6, stream.size()*1e3/decode, decoded, 3*count);
+    return valid && (decoded==(uint32_t)(3*count)) && (delivered==(uint32_t)(3*count));
+}
+
+int main() {
+    bool ok = true;
+    printf("%d publishes of each size over a serial link, best of 3\n", count);
+    for(int size : { 8, 64, 256 }) ok &= run(size);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,97 @@
+/*
+    Payload copies per publish, over the serial, TCP and UDP transports.
+    A borrowed payload is copied into the transfer (counted by the pool) when a transport has to keep it past publish().
+    UDP never keeps the transfer, it copies every payload once into the lwIP buffer it hands the stack, reserved or not.
+    A reserved stream skips the copy into the transfer, so it saves serial and TCP their only copy, and UDP nothing.
+    The WiFi and lwIP layers are the host stand-ins, so TCP writes and UDP datagrams are only counted.
+*/
+#include "bench.h"
+#include "transports/tcp.h"
+#include "transports/udp.h"
+
+static const int publishes = 100000;
+
+// a node with one transport attached, what it has written so far, and how to make it write
+struct CopyCase {
+    const char* name;
+    UAVNode* node;
+    std::function<uint64_t()> wire;
+    std::function<void()> drain;
+    int copies[2];      // whole payload copies expected per publish, borrowed and reserved
+};
+
+static bool run(CopyCase& c, int size) {
+    bool ok = true;
+    uint8_t payload[1024];
+    for(int i=0; i<size; i++) payload[i] = i;
+    UAVNode& node = *c.node;
+    for(int reserved=0; reserved<2; reserved++) {
+        uint32_t copied = node.transfers.copied;
+        uint64_t lwip = host_lwip.ram_bytes - 24*host_lwip.datagrams;
+        uint64_t wire = c.wire();
+        uint64_t ns = bench_best(1, [&]() {
+            for(int i=0; i<publishes; i++) {
+                if(reserved) {
+                    auto stream = node.reserve(size);
+                    stream.output_memcpy(payload, size);
+                    node.publish(1000, 0x1234, UAVTransfer::PriorityNominal, stream);
+                } else {
+                    node.publish(1000, 0x1234, UAVTransfer::PriorityNominal, payload, size);
+                }
+                c.drain();
+            }
+        });
+        double staged = (double)(node.transfers.copied - copied) / publishes;
+        double stack = (double)(host_lwip.ram_bytes - 24*host_lwip.datagrams - lwip) / publishes;
+        double copies = (staged + stack) / size;
+        printf("  %-7s %5d bytes  %-9s %7.1f ns  %6.0f copied to transfer  %6.0f copied to lwip  %4.1f copies  %6.0f on the wire\n",
+            c.name, size, reserved ? "reserved" : "borrowed", (double)ns/publishes, staged, stack, copies, (double)(c.wire()-wire)/publishes);
+        ok &= (copies==c.copies[reserved]);
+    }
+    return ok;
+}
+
+int main() {
+    // the nodes go first, so the transports are gone before the transfer pools they hold on to
+    UAVNode serial_node, tcp_node, udp_node;
+    unsigned long t = 0;
+    // serial, into an in-memory pipe
+    std::deque<uint8_t> rx, tx;
+    BenchPipe pipe(&rx, &tx);
+    SerialTransport serial(pipe);
+    serial_node.local_node_id = 10;
+    serial_node.add(&serial);
+    // tcp, a serial transport over a client socket
+    WiFiClient* client = new WiFiClient(true);
+    TCPSerialTransport* tcp = new TCPSerialTransport(client, new TCPSerialPort(client), true, nullptr);
+    tcp_node.local_node_id = 10;
+    tcp_node.add(tcp);
+    // udp broadcast
+    PortUDPTransport udp(16384);
+    udp_node.local_node_id = 10;
+    udp_node.add(&udp);
+
+    // serial transports queue what they are given, and write it out from the loop
+    CopyCase cases[] = {
+        { "serial", &serial_node, [&]() { return pipe.written; }, [&]() { serial_node.loop(++t, 1); tx.clear(); }, { 1, 0 } },
+        { "tcp",    &tcp_node,    [&]() { return client->written; }, [&]() { tcp_node.loop(++t, 1); }, { 1, 0 } },
+        { "udp",    &udp_node,    [&]() { return host_lwip.bytes; }, []() { }, { 1, 1 } },
+    };
+    printf("payload bytes copied per publish, %d publishes each\n", publishes);
+    bool ok = true;
+    int sizes[] = { 8, 64, 256, 1024 };
+    for(auto& c : cases) {
+        for(int size : sizes) ok &= run(c, size);
+    }
+    if(!ok) printf("copies per publish were not what each transport should make\n");
+    // every datagram buffer went back to the stack
+    if(host_lwip.pbufs!=0) {
+        printf("%d lwip buffers were never freed\n", host_lwip.pbufs);
+        ok = false;
+    }
+    serial_node.remove(&serial);
+    tcp_node.remove(tcp);
+    udp_node.remove(&udp);
+    delete tcp;
+    return ok ? 0 : 1;
+}
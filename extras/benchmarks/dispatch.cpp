@@ -0,0 +1,55 @@
+/*
+    Subject dispatch: lookups per second through UAVNode::transfer_receive at 10, 100 and 1000 subscriptions,
+    against the std::map of std::function listeners the node used to keep.
+    Every other transfer is for a port nobody subscribed to, as on a busy bus in promiscuous mode.
+*/
+#include "bench.h"
+#include <map>
+#include <tuple>
+#include <functional>
+
+static const char* dtname = "bench.Sample.1.0";
+static const int transfers = 1000000;
+static uint32_t delivered = 0;
+
+static void run(int subscriptions) {
+    UAVDatatypeHash datatype = UAVNode::datatypehash(dtname);
+    uint8_t payload[8] = { 0 };
+    UAVTransfer transfer;
+    transfer.transfer_kind = UAVTransfer::KindMessage;
+    transfer.datatype = datatype;
+    transfer.remote_node_id = 5;
+    transfer.local_node_id = 0xFFFF;
+    transfer.payload = payload;
+    transfer.payload_size = sizeof(payload);
+    // ports 0..n-1 are subscribed, n..2n-1 are not
+    UAVNode node(subscriptions);
+    for(int i=0; i<subscriptions; i++) node.subscribe(i, dtname, [](UAVNodeID src, UAVInStream& in) { delivered++; });
+    delivered = 0;
+    uint64_t table = bench_best(5, [&]() {
+        for(int i=0; i<transfers; i++) {
+            transfer.port_id = ((uint32_t)i*7919) % (subscriptions*2);
+            node.transfer_receive(&transfer);
+        }
+    });
+    // the old way: a tree keyed by (port, datatype), where operator[] inserts misses and copies the listener out
+    std::map<std::tuple<UAVPortID,UAVDatatypeHash>, std::function<void(UAVNodeID, UAVInStream&)>> tree;
+    for(int i=0; i<subscriptions; i++) tree[std::make_tuple((UAVPortID)i, datatype)] = [](UAVNodeID src, UAVInStream& in) { delivered++; };
+    uint64_t before = bench_best(5, [&]() {
+        for(int i=0; i<transfers; i++) {
+            transfer.port_id = ((uint32_t)i*7919) % (subscriptions*2);
+            UAVInStream in(transfer.payload, transfer.payload_size);
+            auto fn = tree[std::make_tuple(transfer.port_id, transfer.datatype)];
+            if(fn) fn(transfer.remote_node_id, in);
+        }
+    });
+    printf("%5d subscriptions  port map %6.1f M lookups/s   std::map %6.1f M lookups/s (grew to %d entries)\n",
+        subscriptions, transfers*1000.0/table, transfers*1000.0/before, (int)tree.size());
+}
+
+int main() {
+    run(10);
+    run(100);
+    run(1000);
+    return 0;
+}
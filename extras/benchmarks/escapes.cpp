@@ -0,0 +1,159 @@
+/*
+    Escape scanning, byte by byte as the serial transport used to, against the run-based scan it does now.
+    The byte loops are copies of the old transmit and receive loops. The run loops use SerialTransport::clean_run
+    to find the next delimiter or escape prefix and copy the clean run before it in one go. Both have to produce
+    the same bytes. Last, whole 512 byte frames go through parse_buffer with and without bytes to escape.
+*/
+#include "bench.h"
+
+static const int size = 4096;
+static const int runs = 2000;
+
+// the old transmit loop, a switch on every byte
+static int escape_bytes(const uint8_t* in, int n, uint8_t* out) {
+    int count = 0;
+    for(int i=0; i<n; i++) {
+        uint8_t c = in[i];
+        switch(c) {
+            case UV_SERIAL_FRAME_DELIMITER:
+            case UV_SERIAL_ESCAPE_PREFIX:
+                out[count++] = UV_SERIAL_ESCAPE_PREFIX;
+                out[count++] = c ^ 0xFF;
+                break;
+            default:
+                out[count++] = c;
+                break;
+        }
+    }
+    return count;
+}
+
+// the run-based transmit loop
+static int escape_runs(const uint8_t* in, int n, uint8_t* out) {
+    int count = 0;
+    int i = 0;
+    while(i<n) {
+        int run = SerialTransport::clean_run(&in[i], n-i);
+        memcpy(&out[count], &in[i], run);
+        count += run;
+        i += run;
+        if(i<n) {
+            out[count++] = UV_SERIAL_ESCAPE_PREFIX;
+            out[count++] = in[i++] ^ 0xFF;
+        }
+    }
+    return count;
+}
+
+// the old receive loop, checking every byte for the escape prefix
+static int unescape_bytes(const uint8_t* in, int n, uint8_t* out) {
+    int count = 0;
+    bool escaped = false;
+    for(int i=0; i<n; i++) {
+        uint8_t c = in[i];
+        if(escaped) {
+            out[count++] = c ^ 0xFF;
+            escaped = false;
+        } else if(c==UV_SERIAL_ESCAPE_PREFIX) {
+            escaped = true;
+        } else {
+            out[count++] = c;
+        }
+    }
+    return count;
+}
+
+// the run-based receive loop
+static int unescape_runs(const uint8_t* in, int n, uint8_t* out) {
+    int count = 0;
+    int i = 0;
+    while(i<n) {
+        int run = SerialTransport::clean_run(&in[i], n-i);
+        memcpy(&out[count], &in[i], run);
+        count += run;
+        i += run;
+        if(i+1<n) {
+            out[count++] = in[i+1] ^ 0xFF;
+            i += 2;
+        } else {
+            i = n;
+        }
+    }
+    return count;
+}
+
+// random bytes, with every special'th one a delimiter or escape prefix and none elsewhere
+static void fill(uint8_t* data, int n, int special) {
+    srand(7);
+    for(int i=0; i<n; i++) {
+        uint8_t c = rand();
+        if( (c==UV_SERIAL_FRAME_DELIMITER) || (c==UV_SERIAL_ESCAPE_PREFIX) ) c = 0;
+        if( (special>0) && (i%special==special-1) ) c = (i & 1) ? UV_SERIAL_FRAME_DELIMITER : UV_SERIAL_ESCAPE_PREFIX;
+        data[i] = c;
+    }
+}
+
+static const char* density(int special, char* label) {
+    if(special>0) sprintf(label, "1 in %d", special); else strcpy(label, "none");
+    return label;
+}
+
+template <typename F>
+static double rate(F fn) {
+    uint64_t ns = bench_best(5, [&]() { for(int r=0; r<runs; r++) fn(); });
+    return (double)size*runs*1000.0/ns;
+}
+
+static bool scan(int special) {
+    static uint8_t data[size], a[size*2], b[size*2], c[size], d[size];
+    fill(data, size, special);
+    int na = escape_bytes(data, size, a);
+    int nb = escape_runs(data, size, b);
+    int nc = unescape_bytes(a, na, c);
+    int nd = unescape_runs(a, na, d);
+    bool same = (na==nb) && (memcmp(a, b, na)==0) && (nc==size) && (nd==size) && (memcmp(c, data, size)==0) && (memcmp(d, data, size)==0);
+    double tx_bytes = rate([&]() { bench_keep(escape_bytes(data, size, a)); });
+    double tx_runs = rate([&]() { bench_keep(escape_runs(data, size, b)); });
+    double rx_bytes = rate([&]() { bench_keep(unescape_bytes(a, na, c)); });
+    double rx_runs = rate([&]() { bench_keep(unescape_runs(a, na, d)); });
+    char label[16];
+    printf("  %-10s  escape %7.0f -> %7.0f MB/s (%4.1fx)  unescape %7.0f -> %7.0f MB/s (%4.1fx)%s\n", density(special, label),
+        tx_bytes, tx_runs, tx_runs/tx_bytes, rx_bytes, rx_runs, rx_runs/rx_bytes, same ? "" : "  OUTPUTS DIFFER");
+    return same;
+}
+
+static const char dtname_blob[] PROGMEM = "bench.escapes.Blob.1.0";
+
+static bool parse(int special) {
+    UAVDatatypeHash datatype = UAVNode::datatypehash_P(dtname_blob);
+    uint8_t payload[512];
+    fill(payload, sizeof(payload), special);
+    std::vector<uint8_t> stream = bench_capture(200, [&](UAVNode& node, int i) {
+        node.publish(3000, datatype, UAVTransfer::PriorityNominal, payload, sizeof(payload));
+    });
+    UAVNode node;
+    std::deque<uint8_t> in, out;
+    BenchPipe pipe(&in, &out);
+    SerialTransport transport(pipe);
+    node.local_node_id = 20;
+    int received = 0;
+    node.subscribe(3000, dtname_blob, [&](UAVNodeID node_id, UAVInStream& in) {
+        if( (in.input_size==sizeof(payload)) && (memcmp(in.input_buffer, payload, sizeof(payload))==0) ) received++;
+    });
+    uint64_t ns = bench_best(50, [&]() { transport.parse_buffer(stream.data(), stream.size(), &node); });
+    char label[16];
+    printf("  512 byte frames, special bytes %-8s %7.1f MB/s through parse_buffer\n", density(special, label), stream.size()*1000.0/ns);
+    return received==200*50;
+}
+
+int main() {
+    printf("escape scanning of %d bytes, byte by byte -> in runs, by how often a byte needs escaping\n", size);
+    bool ok = true;
+    int densities[] = { 0, 1024, 256, 64, 16, 4 };
+    for(int special : densities) ok &= scan(special);
+    ok &= parse(0);
+    ok &= parse(256);
+    ok &= parse(16);
+    if(!ok) printf("escaping went wrong\n");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,93 @@
+/*
+    Heap allocations per publish and per request, in steady state.
+    Heap allocations are counted by replacing the global operator new, and checked against the transfer pool's own
+    count of what it had to take from the heap: payloads and frames too big for the inline buffer, and request index entries.
+    Publishes whose payload fits in the inline buffer beside the serial frame header and crc must not allocate at all.
+*/
+#include "bench.h"
+#include <stdlib.h>
+
+static uint64_t allocations = 0;
+
+void* operator new(size_t size) {
+    allocations++;
+    void* p = malloc(size);
+    if(p==nullptr) abort();
+    return p;
+}
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t size) noexcept { free(p); }
+
+// a port that takes everything and keeps nothing, so the link itself never allocates
+class NullPort : public UAVSerialPort {
+    public:
+        void read(uint8_t* buffer, int count) override { }
+        void write(uint8_t* buffer, int count) override { }
+        void flush() override { }
+        int readCount() override { return 0; }
+        int writeCount() override { return 1<<16; }
+};
+
+static const int count = 10000;
+// the biggest payload that shares the inline buffer with its serial frame header and crc
+static const int inline_size = UV_TRANSFER_BUFFER_SIZE - UV_SERIAL_MIN_FRAME_SIZE;
+
+static bool publishes(UAVNode& node, int size, bool reserved, unsigned long& t) {
+    uint8_t payload[2048] = { 0 };
+    uint64_t before = allocations;
+    uint32_t blocks = node.transfers.heap_blocks;
+    for(int i=0; i<count; i++) {
+        if(reserved) {
+            auto stream = node.reserve(size);
+            stream.output_memcpy(payload, size);
+            node.publish(1000, 0x1234, UAVTransfer::PriorityNominal, stream);
+        } else {
+            node.publish(1000, 0x1234, UAVTransfer::PriorityNominal, payload, size);
+        }
+        node.loop(++t, 1);
+    }
+    uint64_t made = allocations - before;
+    blocks = node.transfers.heap_blocks - blocks;
+    printf("  publish %4d bytes %-9s %5.2f allocations each, %5.2f counted by the pool\n",
+        size, reserved ? "reserved" : "borrowed", (double)made/count, (double)blocks/count);
+    if(made!=blocks) return false;
+    return (size > inline_size) || (made==0);
+}
+
+int main() {
+    bool ok = true;
+    unsigned long t = 0;
+    UAVNode node;
+    NullPort port;
+    SerialTransport serial(port);
+    node.local_node_id = 10;
+    node.add(&serial);
+    // warm up, so the first publish of a port doesn't count
+    node.publish(1000, 0x1234, UAVTransfer::PriorityNominal, nullptr, 0);
+    node.loop(++t, 1);
+    printf("heap allocations over a serial transport, %d of each\n", count);
+    for(int size : { 8, inline_size, inline_size+1, UV_TRANSFER_BUFFER_SIZE, 1024 }) {
+        ok &= publishes(node, size, false, t);
+        ok &= publishes(node, size, true, t);
+    }
+    node.remove(&serial);
+    // requests to a transport that sends them all, each timing out in turn
+    UAVNode client;
+    BenchSink sink;
+    client.local_node_id = 10;
+    client.add(&sink);
+    uint64_t before = allocations;
+    uint32_t requests = client.transfers.heap_requests;
+    uint8_t payload[8] = { 0 };
+    for(int i=0; i<count; i++) {
+        client.request(20, 100, 0x1234, UAVTransfer::PriorityNominal, payload, sizeof(payload), nullptr, 10);
+        client.loop(++t, 1);
+    }
+    for(int i=0; i<20; i++) client.loop(++t, 1);
+    uint64_t made = allocations - before;
+    requests = client.transfers.heap_requests - requests;
+    printf("  request    8 bytes           %5.2f allocations each, %5.2f counted by the pool\n", (double)made/count, (double)requests/count);
+    ok &= (made==requests);
+    client.remove(&sink);
+    return ok ? 0 : 1;
+}
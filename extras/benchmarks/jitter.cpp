@@ -0,0 +1,77 @@
+/*
+    Wake jitter for periodic publishers, on a simulated millisecond clock that starts 2 s before the 32-bit wrap.
+    Five publishers and a heartbeat share a node that also streams bulk traffic to its peer.
+    Idle, the loop runs every millisecond. Loaded, it sometimes stalls for up to 8 ms, as if some other code hogged it.
+    Every publisher should wake once per period when idle, and keep its phase when loaded, skipping only the periods a stall swallowed.
+*/
+#include "bench.h"
+#include "apps/heartbeat.h"
+
+static const char dtname_sample[] PROGMEM = "bench.jitter.Sample.1.0";
+static const uint32_t duration = 10000;
+
+class Publisher : public UAVTask {
+    public:
+        UAVPortID subject;
+        uint64_t datatype;
+        Publisher(UAVPortID s, uint32_t p) : subject(s) { period = p; datatype = UAVNode::datatypehash_P(dtname_sample); }
+        void loop(UAVNode& node, const unsigned long t, const int dt) override {
+            uint8_t payload[32] = { 0 };
+            node.publish(subject, datatype, UAVTransfer::PriorityHigh, payload, sizeof(payload));
+        }
+};
+
+static bool run(bool loaded) {
+    BenchLink link;
+    uint32_t periods[] = { 5, 10, 20, 50, 100 };
+    Publisher* publishers[5];
+    uint32_t received[5] = { 0 };
+    for(int i=0; i<5; i++) {
+        publishers[i] = new Publisher(1000+i, periods[i]);
+        link.a.add(publishers[i]);
+        uint32_t* count = &received[i];
+        link.b.subscribe(1000+i, dtname_sample, [count](UAVNodeID node_id, UAVInStream& in) { (*count)++; });
+    }
+    HeartbeatApp heartbeat;
+    link.a.add(&heartbeat);
+    // the loop clock has nothing to do with millis()
+    uint32_t start = 0xFFFFFFFF - 2000;
+    uint32_t t = start;
+    uint8_t bulk[512] = { 0 };
+    srand(1);
+    link.pump(t);
+    while( (uint32_t)(t - start) < duration ) {
+        t++;
+        if(loaded) {
+            if(rand()%10==0) t += rand()%8 + 1;
+            link.a.publish(2000, 0x1234, UAVTransfer::PriorityOptional, bulk, sizeof(bulk));
+        }
+        if( (uint32_t)(t - start) > duration ) t = start + duration;
+        link.pump(t);
+    }
+    link.pump(t);
+    bool ok = true;
+    printf("%s\n", loaded ? "loaded, stalls of 1 to 8 ms on one loop in ten, and a 512 byte optional message per loop" : "idle, a loop every millisecond");
+    for(int i=0; i<6; i++) {
+        UAVScheduled* item = (i<5) ? (UAVScheduled*)publishers[i] : &heartbeat;
+        uint32_t expected = duration / item->period;
+        printf("  %5u ms period  %5u of %5u wakes  late by %5.2f ms on average, %2u ms at most",
+            item->period, item->runs, expected, item->runs ? (double)item->late_total/item->runs : 0.0, item->late_max);
+        if(i<5) printf("  %5u received", received[i]);
+        printf("\n");
+        if(!loaded) ok &= (item->runs==expected) && (item->late_max==0);
+        if(i<5) ok &= (received[i]==publishers[i]->runs);
+        else ok &= (item->runs>=expected*9/10);
+    }
+    for(int i=0; i<5; i++) link.a.remove(publishers[i]);
+    link.a.remove(&heartbeat);
+    for(int i=0; i<5; i++) delete publishers[i];
+    return ok;
+}
+
+int main() {
+    bool ok = run(false);
+    ok &= run(true);
+    if(!ok) printf("publishers missed wakes\n");
+    return ok ? 0 : 1;
+}
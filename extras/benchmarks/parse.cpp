@@ -0,0 +1,67 @@
+/*
+    Receive throughput through SerialTransport::parse_buffer, on a recorded stream of frames.
+    The CRC runs as bytes are unescaped, so a frame is accepted with a compare instead of another pass over it.
+    Frames addressed to another node are dropped as soon as their header is in, without buffering the payload.
+    Frames for us are parsed twice, in one piece, where whole unescaped frames are decoded in place from the read buffer,
+    and in 16 byte reads, where no frame fits in one read and every one is copied into the receive buffer.
+*/
+#include "bench.h"
+
+static const char dtname_telemetry[] PROGMEM = "bench.parse.Telemetry.1.0";
+static const int frames = 2000;
+static const int runs = 20;
+
+// telemetry-like payloads, small readings that never need escaping. headers and crcs still may.
+static void telemetry(uint8_t* data, int size, int seed) {
+    for(int i=0; i<size; i++) data[i] = (uint8_t)((i*7 + seed) & 0x3F);
+}
+
+static bool run(int size, bool foreign) {
+    UAVDatatypeHash datatype = UAVNode::datatypehash_P(dtname_telemetry);
+    std::vector<uint8_t> stream = bench_capture(frames, [&](UAVNode& node, int i) {
+        uint8_t payload[1024];
+        telemetry(payload, size, i);
+        if(foreign) {
+            // a request to some other node on the bus
+            node.request(30, 400, datatype, UAVTransfer::PriorityNominal, payload, size, [](UAVInStream* in) { });
+        } else {
+            node.publish(3000, datatype, UAVTransfer::PriorityNominal, payload, size);
+        }
+    });
+    // the receiver is node 20
+    std::deque<uint8_t> in, out;
+    BenchPipe pipe(&in, &out);
+    SerialTransport transport(pipe);
+    UAVNode node;
+    node.local_node_id = 20;
+    int received = 0;
+    node.subscribe(3000, dtname_telemetry, [&](UAVNodeID node_id, UAVInStream& in) { received++; });
+    uint64_t ns = bench_best(runs, [&]() {
+        transport.parse_buffer(stream.data(), stream.size(), &node);
+    });
+    int expect = foreign ? 0 : frames*runs;
+    printf("  %4d byte %-10s %7.1f MB/s  %6.2f M frames/s  %6.0f ns per frame  %5d delivered  %6u rejected early",
+        size, foreign ? "for others" : "for us", stream.size()*1000.0/ns, frames*1000.0/ns, (double)ns/frames,
+        received/runs, transport.frames_rejected/runs);
+    if(foreign) {
+        printf("\n");
+        return received==expect;
+    }
+    bool ok = (received==expect);
+    received = 0;
+    uint64_t copied = bench_best(runs, [&]() {
+        for(size_t i=0; i<stream.size(); i+=16) transport.parse_buffer(&stream[i], min((int)(stream.size()-i), 16), &node);
+    });
+    printf("   %6.0f ns copied in 16 byte reads\n", (double)copied/frames);
+    return ok && (received==expect);
+}
+
+int main() {
+    printf("parse_buffer on %d frames, best of %d\n", frames, runs);
+    bool ok = true;
+    int sizes[] = { 8, 64, 512 };
+    for(int size : sizes) ok &= run(size, false);
+    for(int size : sizes) ok &= run(size, true);
+    if(!ok) printf("frames were lost\n");
+    return ok ? 0 : 1;
+}
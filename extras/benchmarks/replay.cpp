@@ -0,0 +1,91 @@
+/*
+    Replays recorded traffic through the serial receive path, best of 5, the way extras/replay_bench does with files.
+    The traffic is heartbeats and 64 byte messages from node 10, recorded as raw serial bytes and as a capture.
+    The best run's stats must count every frame, transfer and heartbeat, and rewinding must clear the port's counters.
+*/
+#include "bench.h"
+#include "transports/replay.h"
+#include "apps/heartbeat.h"
+
+static const char dtname_blob[] PROGMEM = "bench.replay.Blob.1.0";
+static const int count = 50000;
+static uint32_t heartbeats = 0;
+static uint32_t transfers = 0;
+
+static ReplayStats run(ReplaySerialPort& port) {
+    port.rewind();
+    UAVNode node;
+    SerialTransport transport(port);
+    transport.promiscuous = true;
+    node.add(&transport);
+    heartbeats = 0;
+    transfers = 0;
+    node.on_receive = [](UAVTransfer* transfer) { transfers++; };
+    node.subscribe(subjectid_uavcan_node_Heartbeat_1_0, dtname_uavcan_node_Heartbeat_1_0, [](UAVNodeID src, UAVInStream& in) { heartbeats++; });
+    while(!port.done()) node.loop(millis(), 1);
+    ReplayStats stats = port.stats(transport);
+    stats.transfers = transfers;
+    stats.heartbeats = heartbeats;
+    node.remove(&transport);
+    return stats;
+}
+
+// every other transfer is a heartbeat
+static void traffic(UAVNode& node, int i) {
+    static HeartbeatApp heartbeat;
+    static uint8_t payload[64] = { 0 };
+    if(i==0) node.define_subject(subjectid_uavcan_node_Heartbeat_1_0, dtname_uavcan_node_Heartbeat_1_0);
+    if(i%2==0) {
+        heartbeat.send(node);
+    } else {
+        node.publish(3000, UAVNode::datatypehash_P(dtname_blob), UAVTransfer::PriorityNominal, payload, sizeof(payload));
+    }
+}
+
+static bool replay(const char* name, ReplaySerialPort& port) {
+    ReplayStats best = { 0 };
+    for(int i=0; i<5; i++) {
+        ReplayStats stats = run(port);
+        if( (i==0) || (stats.elapsed_us < best.elapsed_us) ) best = stats;
+    }
+    printf("  %-10s %8llu bytes  %6.1f MB/s  %8.0f frames/s  %6u frames  %6u transfers  %6u heartbeats  %u crc errors\n",
+        name, (unsigned long long)best.bytes, best.mb_per_s, best.frames_per_s, best.frames, best.transfers, best.heartbeats, best.crc_errors);
+    // rewinding starts the counters over
+    port.write((uint8_t*)"x", 1);
+    port.rewind();
+    bool cleared = (port.bytes_read==0) && (port.bytes_written==0) && (port.elapsed_us==0);
+    if(!cleared) printf("  rewind left the counters set\n");
+    return cleared && (best.frames==(uint32_t)count) && (best.transfers==(uint32_t)count) && (best.heartbeats==(uint32_t)count/2) && (best.crc_errors==0);
+}
+
+int main() {
+    bool ok = true;
+    printf("%d transfers, half of them heartbeats, replayed as fast as the transport reads them, best of 5\n", count);
+    // raw serial bytes
+    std::vector<uint8_t> raw = bench_capture(count, traffic);
+    ReplaySerialPort raw_port(raw.data(), raw.size());
+    ok &= replay("raw", raw_port);
+    // the same traffic seen through a capture port, of which the transmit side is played
+    std::vector<uint8_t> captured;
+    {
+        UAVNode node;
+        std::deque<uint8_t> in, out;
+        BenchPipe pipe(&in, &out);
+        CaptureSerialPort capture(&pipe, false, 2 * raw.size() + (1<<16));
+        SerialTransport transport(capture);
+        node.local_node_id = 10;
+        node.add(&transport);
+        for(int i=0; i<count; i++) {
+            traffic(node, i);
+            node.loop(i, 1);
+        }
+        captured.resize(capture.captureCount());
+        capture.readCapture(captured.data(), captured.size());
+        node.remove(&transport);
+    }
+    ReplaySerialPort capture_port(captured.data(), captured.size());
+    capture_port.direction = UV_CAPTURE_TX;
+    ok &= capture_port.is_capture();
+    ok &= replay("capture", capture_port);
+    return ok ? 0 : 1;
+}
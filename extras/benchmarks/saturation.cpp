@@ -0,0 +1,171 @@
+/*
+    Transmit queue behaviour under saturation, on a simulated 115200 baud bus.
+    A node floods the link with Optional messages at ten times what it can carry, and sends a small Exceptional one
+    every 50 ms. The Exceptional ones should only ever wait for the frame already on the wire. For comparison, the
+    same samples are also sent at Optional priority, where they queue behind the flood.
+    Then the queue capacity: 32 back-to-back requests at one priority all get answered with the default depth,
+    and with a shallow queue, the dropped ones fail their callback at once under each drop policy.
+    Last, an Exceptional message into a queue full of Optional ones. Only drop-oldest evicts one to make room,
+    drop-newest drops the new one and reject refuses it, and both leave the queue as it was.
+*/
+#include "bench.h"
+#include "transports/simbus.h"
+
+static const char dtname_flood[] PROGMEM = "bench.saturation.Flood.1.0";
+static const char dtname_sample[] PROGMEM = "bench.saturation.Sample.1.0";
+static const char dtname_echo[] PROGMEM = "bench.saturation.Echo.1.0";
+
+static bool flood(UAVPriority sample_priority) {
+    // a 128 byte transmit buffer, like a UART fifo, so the wait is in the transport's queues
+    SimulatedSerialBus bus(115200, 0, 0, 128);
+    UAVNode a, b;
+    SerialTransport ta(*bus.connect());
+    SerialTransport tb(*bus.connect());
+    a.local_node_id = 10;
+    b.local_node_id = 20;
+    a.add(&ta);
+    b.add(&tb);
+    UAVDatatypeHash flood_dt = UAVNode::datatypehash_P(dtname_flood);
+    UAVDatatypeHash sample_dt = UAVNode::datatypehash_P(dtname_sample);
+    uint32_t floods = 0, samples = 0, sent = 0;
+    uint64_t latency_total = 0, latency_max = 0;
+    b.subscribe(3000, dtname_flood, [&](UAVNodeID node_id, UAVInStream& in) { floods++; });
+    b.subscribe(3001, dtname_sample, [&](UAVNodeID node_id, UAVInStream& in) {
+        uint64_t stamp;
+        in >> stamp;
+        uint64_t latency = bus.now_us - stamp;
+        latency_total += latency;
+        if(latency>latency_max) latency_max = latency;
+        samples++;
+    });
+    uint8_t payload[200] = { 0 };
+    uint32_t duration = 10000;
+    for(uint32_t ms=0; ms<duration+1000; ms++) {
+        if(ms<duration) {
+            a.publish(3000, flood_dt, UAVTransfer::PriorityOptional, payload, sizeof(payload));
+            if(ms%50==0) {
+                uint8_t sample[8];
+                UAVOutStream out(sample, sizeof(sample));
+                out << (uint64_t)bus.now_us;
+                a.publish(3001, sample_dt, sample_priority, out);
+                sent++;
+            }
+        }
+        bus.advance(1000);
+        a.loop(bus.millis(), 1);
+        b.loop(bus.millis(), 1);
+    }
+    // a full fifo, one flood frame and the sample's own frame, with a few escapes, at 10 bits a byte
+    uint32_t wire_bytes = 128 + (sizeof(payload) + UV_SERIAL_MIN_FRAME_SIZE + 2) + (8 + UV_SERIAL_MIN_FRAME_SIZE + 2) + 16;
+    uint64_t bound_us = (uint64_t)wire_bytes * 10 * 1000000 / 115200;
+    printf("  samples at %-11s %3u of %3u received  latency %6.1f ms on average, %6.1f ms at most (bound %4.1f)   %4u flood messages through, %5u dropped\n",
+        sample_priority==UAVTransfer::PriorityExceptional ? "Exceptional" : "Optional", samples, sent,
+        samples ? latency_total/1000.0/samples : 0.0, latency_max/1000.0, bound_us/1000.0, floods, ta.drops[UAVTransfer::PriorityOptional]);
+    a.remove(&ta);
+    b.remove(&tb);
+    // an exceptional sample waits for at most the frame on the wire and the fifo, plus its own
+    return (sample_priority!=UAVTransfer::PriorityExceptional) || ( (samples==sent) && (latency_max < bound_us) );
+}
+
+static bool burst(int depth, int policy, const char* name) {
+    UAVNode a, b;
+    std::deque<uint8_t> ab, ba;
+    BenchPipe pa(&ba, &ab), pb(&ab, &ba);
+    SerialTransport ta(&pa, false, nullptr, depth);
+    SerialTransport tb(pb);
+    ta.drop_policy = policy;
+    a.local_node_id = 10;
+    b.local_node_id = 20;
+    a.add(&ta);
+    b.add(&tb);
+    b.define_service(100, dtname_echo, [](UAVNode& node, UAVInStream& in, UAVPortReply& reply) {
+        uint8_t buffer[4];
+        UAVOutStream out(buffer, sizeof(buffer));
+        out << (uint32_t)in.input_size;
+        reply(out);
+    });
+    UAVDatatypeHash datatype = UAVNode::datatypehash_P(dtname_echo);
+    const int requests = 32;
+    int answered = 0, failed = 0, first = requests;
+    uint8_t payload[4] = { 0 };
+    for(int i=0; i<requests; i++) {
+        a.request(20, 100, datatype, UAVTransfer::PriorityNominal, payload, sizeof(payload), [&answered,&failed,&first,i](UAVInStream* in) {
+            if(in==nullptr) {
+                failed++;
+            } else {
+                answered++;
+                if(i<first) first = i;
+            }
+        });
+    }
+    // anything dropped has failed already, before any loop ran
+    int failed_at_once = failed;
+    for(unsigned long t=1; t<100; t++) {
+        a.loop(t, 1);
+        b.loop(t, 1);
+    }
+    printf("  queue depth %2d  %-11s %2d of %d requests answered from #%d, %2d failed at once, %2d waiting\n",
+        depth, name, answered, requests, first, failed_at_once, requests - answered - failed);
+    a.remove(&ta);
+    b.remove(&tb);
+    // dropping the oldest keeps the last ones, the other policies keep the first
+    int expect = min(depth, requests);
+    int expect_first = (policy==UV_SERIAL_DROP_OLDEST) ? requests - expect : 0;
+    return (answered==expect) && (first==expect_first) && (failed_at_once==requests-expect) && (failed==failed_at_once);
+}
+
+static bool urgent(int policy, const char* name) {
+    UAVNode a, b;
+    std::deque<uint8_t> ab, ba;
+    BenchPipe pa(&ba, &ab), pb(&ab, &ba);
+    const int depth = 8;
+    SerialTransport ta(&pa, false, nullptr, depth);
+    SerialTransport tb(pb);
+    ta.drop_policy = policy;
+    a.local_node_id = 10;
+    b.local_node_id = 20;
+    a.add(&ta);
+    b.add(&tb);
+    UAVDatatypeHash flood_dt = UAVNode::datatypehash_P(dtname_flood);
+    UAVDatatypeHash sample_dt = UAVNode::datatypehash_P(dtname_sample);
+    int floods = 0, samples = 0;
+    b.subscribe(3000, dtname_flood, [&](UAVNodeID node_id, UAVInStream& in) { floods++; });
+    b.subscribe(3001, dtname_sample, [&](UAVNodeID node_id, UAVInStream& in) { samples++; });
+    uint8_t payload[8] = { 0 };
+    // nothing is written until the loop runs, so these fill the queue
+    for(int i=0; i<depth; i++) a.publish(3000, flood_dt, UAVTransfer::PriorityOptional, payload, sizeof(payload));
+    UAVSendResult result = a.publish(3001, sample_dt, UAVTransfer::PriorityExceptional, payload, sizeof(payload));
+    uint32_t evicted = ta.drops[UAVTransfer::PriorityOptional];
+    for(unsigned long t=1; t<20; t++) {
+        a.loop(t, 1);
+        b.loop(t, 1);
+    }
+    const char* status = result.queued ? "queued" : (result.rejected ? "rejected" : (result.dropped ? "dropped" : "sent"));
+    printf("  queue depth %2d  %-11s Exceptional message %-8s  %u Optional evicted  %d of %d Optional and %d Exceptional received\n",
+        depth, name, status, evicted, floods, depth, samples);
+    a.remove(&ta);
+    b.remove(&tb);
+    switch(policy) {
+        case UV_SERIAL_DROP_OLDEST: return result.queued && (evicted==1) && (floods==depth-1) && (samples==1);
+        case UV_SERIAL_DROP_NEWEST: return result.dropped && (evicted==0) && (floods==depth) && (samples==0);
+        default:                    return result.rejected && (evicted==0) && (floods==depth) && (samples==0);
+    }
+}
+
+int main() {
+    bool ok = true;
+    printf("a 200 byte Optional message every millisecond, and an 8 byte sample every 50 ms\n");
+    ok &= flood(UAVTransfer::PriorityExceptional);
+    ok &= flood(UAVTransfer::PriorityOptional);
+    printf("32 requests sent back to back\n");
+    ok &= burst(UV_SERIAL_QUEUE_DEPTH, UV_SERIAL_DROP_OLDEST, "drop oldest");
+    ok &= burst(8, UV_SERIAL_DROP_OLDEST, "drop oldest");
+    ok &= burst(8, UV_SERIAL_DROP_NEWEST, "drop newest");
+    ok &= burst(8, UV_SERIAL_REJECT, "reject");
+    printf("an Exceptional message into a queue full of Optional ones\n");
+    ok &= urgent(UV_SERIAL_DROP_OLDEST, "drop oldest");
+    ok &= urgent(UV_SERIAL_DROP_NEWEST, "drop newest");
+    ok &= urgent(UV_SERIAL_REJECT, "reject");
+    if(!ok) printf("the queues misbehaved\n");
+    return ok ? 0 : 1;
+}
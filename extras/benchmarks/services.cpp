@@ -0,0 +1,59 @@
+/*
+    Service round trips with more services than the port index holds (UV_NODE_MAX_PORTS).
+    Every service must answer, whether its port made it into the index or not, and whether or not the client
+    named the same datatype. The server's port statistics must count every request and response.
+*/
+#include "bench.h"
+
+static const char dtname_echo[] PROGMEM = "bench.services.Echo.1.0";
+static const int rounds = 200;
+
+static bool run(int services, bool exact) {
+    BenchLink link;
+    for(int i=0; i<services; i++) {
+        link.b.define_service(100+i, dtname_echo, [](UAVNode& node, UAVInStream& in, UAVPortReply& reply) {
+            uint8_t buffer[8];
+            UAVOutStream out(buffer, sizeof(buffer));
+            out << (uint32_t)in.input_size;
+            reply(out);
+        });
+    }
+    UAVDatatypeHash datatype = exact ? UAVNode::datatypehash_P(dtname_echo) : 0;
+    uint32_t answered = 0, timed_out = 0;
+    uint8_t payload[4] = { 1, 2, 3, 4 };
+    unsigned long t = 0;
+    uint64_t ns = bench_best(1, [&]() {
+        for(int r=0; r<rounds; r++) {
+            for(int i=0; i<services; i++) {
+                link.a.request(20, 100+i, datatype, UAVTransfer::PriorityNominal, payload, sizeof(payload), [&](UAVInStream* in) {
+                    if(in==nullptr) timed_out++; else answered++;
+                });
+                link.pump(++t);
+            }
+        }
+    });
+    // let anything unanswered time out
+    for(int i=0; i<=UV_NODE_REQUEST_TIMEOUT; i++) link.pump(++t, 1);
+    uint32_t sent = services * rounds;
+    // the server saw and answered every request on the right port
+    bool counted = true;
+    for(int i=0; i<services; i++) {
+        UAVNodePortInfo* info = link.b.ports.find((100+i) | 0x8000);
+        counted &= (info!=nullptr) && (info->stats_recieved==rounds) && (info->stats_emitted==rounds);
+    }
+    printf("  %3d services  %-17s %7.0f ns per round trip  %6u answered  %4u timed out  statistics %s\n",
+        services, exact ? "same datatype" : "client datatype 0", (double)ns/sent, answered, timed_out, counted ? "counted" : "missing");
+    return (answered==sent) && (timed_out==0) && counted;
+}
+
+int main() {
+    printf("service requests, %d rounds, index capacity %d\n", rounds, UV_NODE_MAX_PORTS);
+    bool ok = true;
+    int counts[] = { 8, 32, 40, 64 };
+    for(int services : counts) {
+        ok &= run(services, true);
+        ok &= run(services, false);
+    }
+    if(!ok) printf("some services went unanswered\n");
+    return ok ? 0 : 1;
+}
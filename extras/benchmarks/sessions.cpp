@@ -0,0 +1,66 @@
+/*
+    Transfer id allocation for requests to 4096 different nodes, round robin.
+    The bounded session table (UV_NODE_MAX_SESSIONS entries) against the unbounded std::map the node used to keep.
+    Evicted sessions must never hand out an id they have handed out before, which is checked for every allocation.
+*/
+#include "bench.h"
+#include <map>
+#include <tuple>
+#include <vector>
+
+static const int nodes = 4096;
+static const int rounds = 64;
+static const UAVPortID port = 0x8000 | 430;
+
+int main() {
+    // the bounded table
+    UAVSessionCounters table(UV_NODE_MAX_SESSIONS);
+    std::vector<UAVTransferID> last(nodes, 0);
+    std::vector<bool> seen(nodes, false);
+    uint64_t ns = bench_ns();
+    for(int r=0; r<rounds; r++) {
+        for(int n=0; n<nodes; n++) {
+            UAVTransferID id = table.next(port, n);
+            if(seen[n] && (id<=last[n])) {
+                printf("node %d reused transfer id %llu\n", n, (unsigned long long)id);
+                return 1;
+            }
+            seen[n] = true;
+            last[n] = id;
+        }
+    }
+    ns = bench_ns() - ns;
+    int total = nodes*rounds;
+    printf("session table  %5.1f ns per id  %6d bytes  %u evictions\n",
+        (double)ns/total, (int)(UV_NODE_MAX_SESSIONS*sizeof(UAVTransferID)*2), table.evictions);
+    // the old way: find, then insert on a miss, in a map that only grows
+    std::map<std::tuple<UAVPortID,UAVNodeID>, UAVTransferID> tree;
+    uint64_t sum = 0;
+    ns = bench_ns();
+    for(int r=0; r<rounds; r++) {
+        for(int n=0; n<nodes; n++) {
+            auto key = std::make_tuple(port, (UAVNodeID)n);
+            auto it = tree.find(key);
+            if(it==tree.end()) it = tree.insert(std::make_pair(key, (UAVTransferID)0)).first;
+            sum += it->second++;
+        }
+    }
+    ns = bench_ns() - ns;
+    bench_keep(sum);
+    // a red-black tree node is the key and value plus three pointers and a colour
+    int node_size = sizeof(std::tuple<UAVPortID,UAVNodeID>) + sizeof(UAVTransferID) + 4*sizeof(void*);
+    printf("std::map       %5.1f ns per id  %6d bytes  %d entries\n", (double)ns/total, (int)tree.size()*node_size, (int)tree.size());
+    // and through the node, where each request also sets up its timeout and callback
+    BenchSink sink;
+    UAVNode node;
+    node.local_node_id = 1;
+    node.add(&sink);
+    node.loop(0, 1);
+    uint8_t payload[1] = { 0 };
+    ns = bench_ns();
+    for(int n=0; n<nodes; n++) node.request(n, port & 0x3FFF, 1, UAVTransfer::PriorityNominal, payload, 0, nullptr, 1000);
+    ns = bench_ns() - ns;
+    printf("node.request   %5.1f ns per request to a new node\n", (double)ns/nodes);
+    node.remove(&sink);
+    return 0;
+}
@@ -0,0 +1,72 @@
+/*
+    Two nodes on their own threads, joined by an SPSCSerialLink. Node 10's thread publishes as fast as its transport
+    will take them, pacing itself with writable(), and node 20's thread receives them.
+    Every message must arrive, with no crc errors and nothing lost to a full ring.
+    A thread with nothing to do yields, so the pair also gets somewhere on a single core.
+*/
+#include "bench.h"
+#include <atomic>
+#include <thread>
+
+static const char dtname_blob[] PROGMEM = "bench.threadlink.Blob.1.0";
+static const int count = 100000;
+
+static bool run(int size, int ring) {
+    SPSCSerialLink link(ring);
+    UAVNode a, b;
+    SerialTransport ta(link.a);
+    SerialTransport tb(link.b);
+    a.local_node_id = 10;
+    b.local_node_id = 20;
+    a.add(&ta);
+    b.add(&tb);
+    std::atomic<int> received(0);
+    std::atomic<bool> done(false);
+    uint64_t bytes = 0;
+    b.subscribe(3000, dtname_blob, [&](UAVNodeID node_id, UAVInStream& in) {
+        bytes += in.input_size;
+        received.fetch_add(1, std::memory_order_relaxed);
+    });
+    UAVDatatypeHash datatype = UAVNode::datatypehash_P(dtname_blob);
+    uint64_t deadline = bench_ns() + 20000000000ULL;
+    uint64_t ns = bench_ns();
+    std::thread sender([&]() {
+        uint8_t payload[1024] = { 0 };
+        int sent = 0;
+        while(!done.load() && (bench_ns() < deadline)) {
+            if( (sent<count) && a.writable(UAVTransfer::PriorityNominal) ) {
+                a.publish(3000, datatype, UAVTransfer::PriorityNominal, payload, size);
+                sent++;
+            }
+            a.loop(millis(), 1);
+            // the ring is full, or everything has been sent
+            if(link.a.writeCount() < 16 || sent==count) std::this_thread::yield();
+        }
+    });
+    std::thread receiver([&]() {
+        while( (received.load(std::memory_order_relaxed) < count) && (bench_ns() < deadline) ) {
+            b.loop(millis(), 1);
+            if(link.b.readCount()==0) std::this_thread::yield();
+        }
+        done.store(true);
+    });
+    receiver.join();
+    sender.join();
+    ns = bench_ns() - ns;
+    int got = received.load();
+    printf("  %4d byte payloads  %6d byte rings  %9.0f frames/s  %7.1f MB/s  %6d of %d received  %u crc errors  %u overruns\n",
+        size, ring, got*1e9/ns, bytes*1e3/ns, got, count, tb.crc_errors, link.a.overruns + link.b.overruns);
+    a.remove(&ta);
+    b.remove(&tb);
+    return (got==count) && (tb.crc_errors==0) && (link.a.overruns==0) && (link.b.overruns==0);
+}
+
+int main() {
+    bool ok = true;
+    printf("%d publishes from one thread to another over an SPSCSerialLink\n", count);
+    for(int ring : { 1024, 16384 }) {
+        for(int size : { 8, 64, 256, 1024 }) ok &= run(size, ring);
+    }
+    if(!ok) printf("messages were lost between the threads\n");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,50 @@
+/*
+    Request timeouts: the cost of a node loop with 0 to 10000 requests outstanding, and of issuing each request.
+    The loop cost should stay flat as requests pile up. The clock starts just short of the 32-bit wrap,
+    so every timeout also has to survive it, and all of them must fire exactly once.
+*/
+#include "bench.h"
+
+static const char* dtname = "bench.Ping.1.0";
+static uint32_t timeouts = 0;
+
+static void run(int outstanding) {
+    UAVDatatypeHash datatype = UAVNode::datatypehash(dtname);
+    BenchSink sink;
+    UAVNode node;
+    node.local_node_id = 1;
+    node.add(&sink);
+    uint32_t t = 0xFFFFFFFF - 20000;
+    node.loop(t, 1);
+    timeouts = 0;
+    uint8_t payload[4] = { 0 };
+    // timeouts between 30 and 31 seconds away, so none go off while the loop is timed
+    uint64_t issue = bench_ns();
+    for(int i=0; i<outstanding; i++) {
+        node.request(2 + i%4000, 100, datatype, UAVTransfer::PriorityNominal, payload, sizeof(payload),
+            [](UAVInStream* in) { if(in==nullptr) timeouts++; }, 30000 + i%1000);
+    }
+    issue = bench_ns() - issue;
+    // a millisecond per loop
+    int loops = 10000;
+    uint64_t elapsed = bench_ns();
+    for(int i=0; i<loops; i++) node.loop(++t, 1);
+    elapsed = bench_ns() - elapsed;
+    // run past every deadline, across the wrap
+    for(int i=0; i<25000; i++) node.loop(++t, 1);
+    printf("%6d outstanding  %7.1f ns per loop  %7.1f ns per request  %d timed out\n",
+        outstanding, (double)elapsed/loops, outstanding ? (double)issue/outstanding : 0.0, timeouts);
+    if((int)timeouts!=outstanding) {
+        printf("expected %d timeouts\n", outstanding);
+        exit(1);
+    }
+    node.remove(&sink);
+}
+
+int main() {
+    run(0);
+    run(100);
+    run(1000);
+    run(10000);
+    return 0;
+}
@@ -0,0 +1,151 @@
+/*
+    Bytes on the wire for the standard apps over a point-to-point serial link, with compact frames off,
+    negotiated on both ends, and negotiated on one end facing a peer that never sends them.
+    Heartbeats go both ways once a simulated second. node 10 makes node.GetInfo, node.ExecuteCommand,
+    port.GetInfo and port.GetStatistics requests to node 20, and every one must be answered.
+    Hellos are counted in with the traffic they go out among. A peer that never answers gets UV_SERIAL_HELLO_TRIES of them.
+    Last, node 20 reboots with compact frames off after both ends negotiated them, and node 10 must go back to version 0.
+*/
+#include "bench.h"
+#include "apps/heartbeat.h"
+#include "apps/nodeinfo.h"
+#include "apps/portinfo.h"
+
+static const int count = 100;
+
+class Wire {
+    public:
+        BenchLink link;
+        HeartbeatApp ha, hb;
+        unsigned long t = 0;
+        int answered = 0;
+        Wire(int compact_a, int compact_b) {
+            link.ta.compact = compact_a;
+            link.tb.compact = compact_b;
+            for(UAVNode* node : { &link.a, &link.b }) {
+                node->define_subject(subjectid_uavcan_node_Heartbeat_1_0, dtname_uavcan_node_Heartbeat_1_0);
+                NodeinfoApp::app_v1(node);
+                PortinfoApp::app_v1(node);
+            }
+        }
+        // runs fn count times, a simulated second apart, and returns the bytes written each way
+        template <typename F>
+        void phase(F fn, uint64_t* ab, uint64_t* ba) {
+            uint64_t a = link.pa.written, b = link.pb.written;
+            for(int i=0; i<count; i++) {
+                fn();
+                t += 1000;
+                link.pump(t);
+            }
+            *ab = link.pa.written - a;
+            *ba = link.pb.written - b;
+        }
+        void request(UAVPortID service_id, UAVDatatypeHash datatype, UAVOutStream& out) {
+            link.a.request(20, service_id, datatype, UAVTransfer::PriorityNominal, out, [this](UAVInStream* in) {
+                if(in!=nullptr) answered++;
+            });
+        }
+};
+
+// a heartbeat each way, once a simulated second
+static void heartbeats(Wire& w, uint64_t* ab, uint64_t* ba) {
+    w.phase([&]() { w.ha.send(w.link.a); w.hb.send(w.link.b); }, ab, ba);
+}
+
+typedef struct {
+    const char* name;
+    uint64_t ab, ba;
+} WirePhase;
+
+static const int phases = 5;
+
+static bool run(int compact_a, int compact_b, WirePhase* result) {
+    Wire w(compact_a, compact_b);
+    WirePhase* r = result;
+    r->name = "heartbeat each way";
+    heartbeats(w, &r->ab, &r->ba);
+    r++;
+    r->name = "node.GetInfo";
+    w.phase([&]() {
+        NodeinfoApp::GetInfo(&w.link.a, 20, [&](NodeGetInfoReply* reply) { if(reply!=nullptr) w.answered++; });
+    }, &r->ab, &r->ba);
+    r++;
+    r->name = "node.ExecuteCommand";
+    w.phase([&]() {
+        NodeinfoApp::ExecuteCommand(&w.link.a, 20, 1000, (char*)"bench", [&](NodeExecuteCommandReply* reply) { if(reply!=nullptr) w.answered++; });
+    }, &r->ab, &r->ba);
+    r++;
+    r->name = "port.GetInfo";
+    w.phase([&]() {
+        PortGetInfoRequest request;
+        request.port_id.as_subject(subjectid_uavcan_node_Heartbeat_1_0);
+        uint8_t buffer[8];
+        UAVOutStream out(buffer, sizeof(buffer));
+        out << request;
+        w.request(serviceid_uavcan_port_GetInfo_1_0, dthash_uavcan_port_GetInfo_1_0, out);
+    }, &r->ab, &r->ba);
+    r++;
+    r->name = "port.GetStatistics";
+    w.phase([&]() {
+        PortGetStatisticsRequest request;
+        request.port_id.as_subject(subjectid_uavcan_node_Heartbeat_1_0);
+        uint8_t buffer[8];
+        UAVOutStream out(buffer, sizeof(buffer));
+        out << request;
+        w.request(serviceid_uavcan_port_GetStatistics_1_0, dthash_uavcan_port_GetStatistics_1_0, out);
+    }, &r->ab, &r->ba);
+    return w.answered == 4*count;
+}
+
+static bool reboot(uint64_t off_ab) {
+    Wire w(UV_SERIAL_COMPACT_AUTO, UV_SERIAL_COMPACT_AUTO);
+    uint64_t before, after, ba;
+    heartbeats(w, &before, &ba);
+    // node 20 comes back up with compact frames off, like firmware that predates them
+    SerialTransport old(w.link.pb);
+    old.compact = UV_SERIAL_COMPACT_OFF;
+    w.link.b.remove(&w.link.tb);
+    w.link.b.add(&old);
+    heartbeats(w, &after, &ba);
+    w.link.b.remove(&old);
+    printf("  node 20 reboots with compact frames off: 10->20 %5.1f bytes per heartbeat before, %5.1f after, %5.1f with both off\n",
+        (double)before/count, (double)after/count, (double)off_ab/count);
+    // back to version 0 from the first heartbeat heard, plus a few hellos it doesn't answer
+    return (after + off_ab/count >= off_ab) && (after <= off_ab + UV_SERIAL_HELLO_TRIES*(2*UV_SERIAL_HELLO_SIZE+2));
+}
+
+int main() {
+    static const char* names[3] = { "off", "auto", "on" };
+    static const int modes[3][2] = {
+        { UV_SERIAL_COMPACT_OFF, UV_SERIAL_COMPACT_OFF },
+        { UV_SERIAL_COMPACT_AUTO, UV_SERIAL_COMPACT_AUTO },
+        { UV_SERIAL_COMPACT_AUTO, UV_SERIAL_COMPACT_OFF },
+    };
+    WirePhase results[3][phases];
+    bool ok = true;
+    for(int m=0; m<3; m++) {
+        bool answered = run(modes[m][0], modes[m][1], results[m]);
+        if(!answered) printf("compact %s against %s: requests went unanswered\n", names[modes[m][0]], names[modes[m][1]]);
+        ok &= answered;
+    }
+    printf("serial bytes per transfer, %d of each, 10->20 / 20->10\n", count);
+    printf("  %-20s %17s %17s %17s\n", "", "off / off", "auto / auto", "auto / off");
+    uint64_t total[3] = { 0, 0, 0 };
+    for(int p=0; p<phases; p++) {
+        printf("  %-20s", results[0][p].name);
+        for(int m=0; m<3; m++) {
+            WirePhase* r = &results[m][p];
+            printf("   %6.1f / %6.1f", (double)r->ab/count, (double)r->ba/count);
+            total[m] += r->ab + r->ba;
+        }
+        printf("\n");
+    }
+    printf("  %-20s", "total bytes");
+    for(int m=0; m<3; m++) printf("   %15llu", (unsigned long long)total[m]);
+    printf("\n");
+    // negotiating both ends saves bytes, and a peer that never sends compact frames only costs a few hellos, escaped at worst
+    ok &= (total[1] < total[0]);
+    ok &= (total[2] >= total[0]) && (total[2] <= total[0] + UV_SERIAL_HELLO_TRIES*(2*UV_SERIAL_HELLO_SIZE+2));
+    ok &= reboot(results[0][0].ab);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,54 @@
+/*
+    Offline decoder for CaptureSerialPort streams.
+    Prints one line per transfer, with the time, direction, priority, kind, port, nodes and payload.
+        capture_decode capture.bin
+        capture_decode - < capture.bin
+    Build it with `make` in extras, which puts it in extras/build.
+    Node ids print as source -> destination, with 65535 for broadcasts.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "transports/capture.h"
+
+static CaptureDecoder decoder;
+static int dump = 16;
+
+static void print_transfer(UAVTransfer* t) {
+    static const char* kinds[] = { "msg", "resp", "req", "?" };
+    printf("%10llu.%06llu %s p%d %-4s port %-5d %3d -> %-3d tid %-4llu %4d bytes ",
+        (unsigned long long)(decoder.time_us / 1000000), (unsigned long long)(decoder.time_us % 1000000),
+        decoder.direction==UV_CAPTURE_RX ? "rx" : "tx",
+        t->priority, kinds[t->transfer_kind & 3], t->port_id, t->remote_node_id, t->local_node_id,
+        (unsigned long long)t->transfer_id, (int)t->payload_size);
+    for(int i=0; (i<(int)t->payload_size) && (i<dump); i++) printf("%02x", t->payload[i]);
+    if((int)t->payload_size>dump) printf("..");
+    printf("\n");
+}
+
+int main(int argc, char** argv) {
+    if(argc<2) {
+        fprintf(stderr, "usage: %s <capture file | -> [payload bytes to show]\n", argv[0]);
+        return 2;
+    }
+    FILE* f = strcmp(argv[1],"-")==0 ? stdin : fopen(argv[1], "rb");
+    if(!f) {
+        perror(argv[1]);
+        return 1;
+    }
+    if(argc>2) dump = atoi(argv[2]);
+    decoder.node.on_receive = print_transfer;
+    uint8_t block[4096];
+    size_t n;
+    while( (n = fread(block, 1, sizeof(block), f)) > 0 ) {
+        if(!decoder.decode(block, n)) {
+            fprintf(stderr, "not a capture stream, or corrupt after %u records\n", decoder.records);
+            return 1;
+        }
+    }
+    // frames the transports threw out, so gaps and line noise show up
+    fprintf(stderr, "%u records, %u bytes lost in capture, rx %u rejected %u dictionary misses, tx %u rejected %u dictionary misses\n",
+        decoder.records, decoder.lost,
+        decoder.rx.frames_rejected, decoder.rx.dict_misses, decoder.tx.frames_rejected, decoder.tx.dict_misses);
+    return 0;
+}
@@ -0,0 +1,90 @@
+#ifndef LIBUAVESP_HOST_ARDUINO_H_INCLUDED
+#define LIBUAVESP_HOST_ARDUINO_H_INCLUDED
+
+/*
+    Just enough of the Arduino core to build the library on a Linux or macOS host, for the tools and benchmarks in extras.
+    Serial prints to stdout, and there is nothing to read from it. PROGMEM is ordinary memory.
+*/
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+#include <string>
+
+using std::min;
+using std::max;
+
+typedef const char* PGM_P;
+#define PROGMEM
+#define PSTR(s) (s)
+#define FPSTR(p) (p)
+#define strlen_P strlen
+#define strncpy_P strncpy
+#define memcpy_P memcpy
+#define pgm_read_byte(p) (*(const uint8_t*)(p))
+#define pgm_read_dword(p) (*(const uint32_t*)(p))
+
+#define HEX 16
+#define DEC 10
+
+typedef std::string String;
+
+inline unsigned long millis() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec*1000UL + ts.tv_nsec/1000000;
+}
+inline unsigned long micros() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec*1000000UL + ts.tv_nsec/1000;
+}
+inline void delay(unsigned long ms) {
+    timespec ts = { (time_t)(ms/1000), (long)(ms%1000)*1000000 };
+    nanosleep(&ts, nullptr);
+}
+inline void yield() { }
+inline long random(long howbig) { return howbig>0 ? rand() % howbig : 0; }
+
+class HardwareSerial {
+    public:
+        void begin(unsigned long baud) { }
+        int available() { return 0; }
+        int availableForWrite() { return 4096; }
+        int read() { return -1; }
+        size_t readBytes(uint8_t* buffer, size_t count) { return 0; }
+        size_t write(uint8_t c) { return fwrite(&c, 1, 1, stdout); }
+        size_t write(const uint8_t* buffer, size_t count) { return fwrite(buffer, 1, count, stdout); }
+        void flush() { fflush(stdout); }
+        void print(const char* s) { fputs(s, stdout); }
+        void print(const String& s) { fputs(s.c_str(), stdout); }
+        void print(char c) { putchar(c); }
+        void print(double v, int digits = 2) { printf("%.*f", digits, v); }
+        void print(long long v, int base = DEC) { if(base==HEX) printf("%llx", v); else printf("%lld", v); }
+        void print(unsigned long long v, int base = DEC) { if(base==HEX) printf("%llx", v); else printf("%llu", v); }
+        void print(int v, int base = DEC) { print((long long)v, base); }
+        void print(long v, int base = DEC) { print((long long)v, base); }
+        void print(unsigned char v, int base = DEC) { print((unsigned long long)v, base); }
+        void print(unsigned int v, int base = DEC) { print((unsigned long long)v, base); }
+        void print(unsigned long v, int base = DEC) { print((unsigned long long)v, base); }
+        void print(unsigned short v, int base = DEC) { print((unsigned long long)v, base); }
+        void print(short v, int base = DEC) { print((long long)v, base); }
+        void println() { putchar('\n'); }
+        template <typename T> void println(const T& v) { print(v); println(); }
+        template <typename T> void println(const T& v, int base) { print(v, base); println(); }
+};
+extern HardwareSerial Serial;
+
+class EspClass {
+    public:
+        String getSketchMD5() { return String(32, '0'); }
+        uint32_t getChipId() { return 0; }
+        uint32_t getFlashChipId() { return 0; }
+        uint64_t getEfuseMac() { return 0; }
+};
+extern EspClass ESP;
+
+#endif
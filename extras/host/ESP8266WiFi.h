@@ -0,0 +1,51 @@
+#ifndef LIBUAVESP_HOST_ESP8266WIFI_H_INCLUDED
+#define LIBUAVESP_HOST_ESP8266WIFI_H_INCLUDED
+
+/*
+    Stand-in for the ESP8266 WiFi library, so the UDP and TCP transports build on a host.
+    The station sits at 192.168.1.10/24. Clients count what is written to them and never have anything to read.
+*/
+#include "Arduino.h"
+
+class IPAddress {
+    protected:
+        uint32_t _address;
+    public:
+        IPAddress(uint32_t address = 0) : _address(address) { }
+        IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) : _address(a | (b<<8) | (c<<16) | ((uint32_t)d<<24)) { }
+        uint32_t v4() const { return _address; }
+        uint8_t operator[](int index) const { return (_address >> (index*8)) & 0xFF; }
+};
+
+class ESP8266WiFiClass {
+    public:
+        IPAddress localIP() { return IPAddress(192,168,1,10); }
+        IPAddress subnetMask() { return IPAddress(255,255,255,0); }
+};
+extern ESP8266WiFiClass WiFi;
+
+class WiFiClient {
+    protected:
+        bool _connected;
+    public:
+        uint64_t written = 0;
+        WiFiClient(bool connected = false) : _connected(connected) { }
+        explicit operator bool() const { return _connected; }
+        uint8_t connected() { return _connected; }
+        void stop() { _connected = false; }
+        int available() { return 0; }
+        int availableForWrite() { return 4096; }
+        size_t readBytes(uint8_t* buffer, size_t count) { return 0; }
+        size_t write(const uint8_t* buffer, size_t count) { written += count; return count; }
+        void flush() { }
+};
+
+class WiFiServer {
+    public:
+        WiFiServer(uint16_t port) { }
+        void begin() { }
+        void stop() { }
+        WiFiClient available() { return WiFiClient(); }
+};
+
+#endif
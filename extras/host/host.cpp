@@ -0,0 +1,6 @@
+#include "Arduino.h"
+#include "ESP8266WiFi.h"
+
+HardwareSerial Serial;
+EspClass ESP;
+ESP8266WiFiClass WiFi;
@@ -0,0 +1,64 @@
+#include "lwip/udp.h"
+
+HostLwipStats host_lwip;
+
+pbuf* pbuf_alloc(pbuf_layer layer, u16_t length, pbuf_type type) {
+    pbuf* p = new pbuf();
+    p->next = nullptr;
+    p->payload = (type==PBUF_RAM || type==PBUF_POOL) ? new uint8_t[length] : nullptr;
+    p->tot_len = length;
+    p->len = length;
+    p->type = type;
+    if(p->payload!=nullptr) host_lwip.ram_bytes += length; else host_lwip.ref_bytes += length;
+    host_lwip.pbufs++;
+    return p;
+}
+
+// frees the whole chain. lwIP reference counts each pbuf, but nothing here takes a second reference.
+u8_t pbuf_free(pbuf* p) {
+    u8_t count = 0;
+    while(p!=nullptr) {
+        pbuf* next = p->next;
+        if(p->type==PBUF_RAM || p->type==PBUF_POOL) delete[] (uint8_t*)p->payload;
+        delete p;
+        host_lwip.pbufs--;
+        count++;
+        p = next;
+    }
+    return count;
+}
+
+void pbuf_cat(pbuf* head, pbuf* tail) {
+    pbuf* p = head;
+    while(p->next!=nullptr) {
+        p->tot_len += tail->tot_len;
+        p = p->next;
+    }
+    p->tot_len += tail->tot_len;
+    p->next = tail;
+}
+
+udp_pcb* udp_new() {
+    return new udp_pcb();
+}
+
+// the transports delete the pcb themselves after removing it, so there is nothing to free here
+void udp_remove(udp_pcb* pcb) { }
+
+err_t udp_bind(udp_pcb* pcb, const ip_addr_t* ipaddr, u16_t port) {
+    pcb->local_ip = *ipaddr;
+    pcb->local_port = port;
+    return ERR_OK;
+}
+
+void udp_recv(udp_pcb* pcb, udp_recv_fn recv, void* recv_arg) {
+    pcb->recv = recv;
+    pcb->recv_arg = recv_arg;
+}
+
+err_t udp_sendto(udp_pcb* pcb, pbuf* p, const ip_addr_t* dst_ip, u16_t dst_port) {
+    if(p==nullptr) return ERR_VAL;
+    host_lwip.datagrams++;
+    host_lwip.bytes += p->tot_len;
+    return ERR_OK;
+}
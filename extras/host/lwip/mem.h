@@ -0,0 +1 @@
+#include "opt.h"
@@ -0,0 +1,18 @@
+#ifndef LIBUAVESP_HOST_LWIP_OPT_H_INCLUDED
+#define LIBUAVESP_HOST_LWIP_OPT_H_INCLUDED
+
+/*
+    Stand-in for the lwIP headers the UDP transport includes. The types and calls it uses are in lwip/udp.h.
+*/
+#include <stdint.h>
+
+typedef uint8_t  u8_t;
+typedef uint16_t u16_t;
+typedef uint32_t u32_t;
+typedef int8_t   err_t;
+
+#define ERR_OK   0
+#define ERR_MEM  -1
+#define ERR_VAL  -6
+
+#endif
@@ -0,0 +1,55 @@
+#ifndef LIBUAVESP_HOST_LWIP_UDP_H_INCLUDED
+#define LIBUAVESP_HOST_LWIP_UDP_H_INCLUDED
+
+/*
+    Just enough of the lwIP raw udp api for the UDP transport. Nothing goes on a network:
+    sent datagrams are counted in host_lwip, along with the bytes lwIP had to hold in its own memory for them.
+*/
+#include "opt.h"
+
+struct ip_addr_t {
+    u32_t addr;
+};
+
+enum pbuf_layer { PBUF_TRANSPORT, PBUF_IP, PBUF_LINK, PBUF_RAW };
+enum pbuf_type  { PBUF_RAM, PBUF_ROM, PBUF_REF, PBUF_POOL };
+
+struct pbuf {
+    pbuf*       next;
+    void*       payload;
+    u16_t       tot_len;
+    u16_t       len;
+    pbuf_type   type;
+};
+
+struct udp_pcb;
+typedef void (*udp_recv_fn)(void *arg, struct udp_pcb *pcb, struct pbuf *p, const ip_addr_t *addr, u16_t port);
+
+struct udp_pcb {
+    ip_addr_t   local_ip = {0};
+    u16_t       local_port = 0;
+    udp_recv_fn recv = nullptr;
+    void*       recv_arg = nullptr;
+};
+
+// what the stack was asked to do
+struct HostLwipStats {
+    uint64_t    datagrams = 0;  // udp_sendto calls that succeeded
+    uint64_t    bytes = 0;      // datagram bytes sent, headers included
+    uint64_t    ram_bytes = 0;  // bytes allocated in PBUF_RAM buffers
+    uint64_t    ref_bytes = 0;  // bytes referenced by PBUF_REF and PBUF_ROM buffers
+    int         pbufs = 0;      // pbufs not yet freed
+};
+extern HostLwipStats host_lwip;
+
+pbuf* pbuf_alloc(pbuf_layer layer, u16_t length, pbuf_type type);
+u8_t pbuf_free(pbuf* p);
+void pbuf_cat(pbuf* head, pbuf* tail);
+
+udp_pcb* udp_new();
+void udp_remove(udp_pcb* pcb);
+err_t udp_bind(udp_pcb* pcb, const ip_addr_t* ipaddr, u16_t port);
+void udp_recv(udp_pcb* pcb, udp_recv_fn recv, void* recv_arg);
+err_t udp_sendto(udp_pcb* pcb, pbuf* p, const ip_addr_t* dst_ip, u16_t dst_port);
+
+#endif
@@ -0,0 +1,62 @@
+/*
+    Plays a recorded serial stream through the receive path and reports how fast it went.
+    The stream is raw serial bytes, or a capture from CaptureSerialPort, whose received side is played.
+        replay_bench traffic.bin            as fast as possible, best of 5 runs
+        replay_bench capture.bin timed      at the capture's own pace
+        replay_bench capture.bin fast 20    best of 20 runs
+    Build it with `make` in extras, which puts it in extras/build.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "transports/replay.h"
+#include "apps/heartbeat.h"
+
+static uint32_t heartbeats = 0;
+static uint32_t transfers = 0;
+
+static ReplayStats run(ReplaySerialPort& port) {
+    port.rewind();
+    UAVNode node;
+    // a node of its own, which takes traffic for every node the way a bus monitor would
+    SerialTransport transport(port);
+    transport.promiscuous = true;
+    node.add(&transport);
+    heartbeats = 0;
+    transfers = 0;
+    node.on_receive = [](UAVTransfer* transfer) { transfers++; };
+    node.subscribe(subjectid_uavcan_node_Heartbeat_1_0, dtname_uavcan_node_Heartbeat_1_0, [](UAVNodeID src, UAVInStream& in) { heartbeats++; });
+    while(!port.done()) node.loop(millis(), 1);
+    ReplayStats stats = port.stats(transport);
+    stats.transfers = transfers;
+    stats.heartbeats = heartbeats;
+    node.remove(&transport);
+    return stats;
+}
+
+int main(int argc, char** argv) {
+    if(argc<2) {
+        fprintf(stderr, "usage: %s <file> [fast|timed] [runs]\n", argv[0]);
+        return 2;
+    }
+    bool timed = (argc>2) && (strcmp(argv[2],"timed")==0);
+    int runs = argc>3 ? atoi(argv[3]) : (timed ? 1 : 5);
+    if(runs<1) runs = 1;
+    ReplaySerialPort port(argv[1], timed);
+    if(!port.is_open()) {
+        perror(argv[1]);
+        return 1;
+    }
+    // the fastest run is the one least disturbed by everything else on the machine
+    ReplayStats best = { 0 };
+    for(int i=0; i<runs; i++) {
+        ReplayStats stats = run(port);
+        if( (i==0) || (stats.elapsed_us < best.elapsed_us) ) best = stats;
+    }
+    printf("%s %s, %llu bytes in %u us\n", port.is_capture() ? "capture" : "raw stream", timed ? "timed" : "fast",
+        (unsigned long long)best.bytes, best.elapsed_us);
+    printf("%u frames, %.0f frames/s, %.1f MB/s\n", best.frames, best.frames_per_s, best.mb_per_s);
+    printf("%u transfers, %u heartbeats\n", best.transfers, best.heartbeats);
+    printf("%u crc errors, %u frames rejected, %llu out-of-band bytes\n", best.crc_errors, best.rejected, (unsigned long long)best.oob_bytes);
+    return 0;
+}
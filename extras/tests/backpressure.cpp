@@ -0,0 +1,85 @@
+/*
+    Send status and backpressure: what publish() says each transport did with a transfer, what on_complete sees,
+    and on_writable once a full serial queue has room again.
+*/
+#include "test.h"
+
+static const char dtname_blob[] PROGMEM = "test.backpressure.Blob.1.0";
+
+static int completed = 0, went_out = 0, gave_up = 0;
+static void complete(UAVTransfer* transfer, void* context) {
+    completed++;
+    if(transfer->sent_count>0) went_out++;
+    if(transfer->drop_count>0) gave_up++;
+}
+
+static void statuses() {
+    UAVNode a, b;
+    std::deque<uint8_t> ab, ba;
+    BenchPipe pa(&ba, &ab), pb(&ab, &ba);
+    const int depth = 4;
+    SerialTransport serial(&pa, false, nullptr, depth);
+    SerialTransport tb(pb);
+    BenchSink sink;
+    serial.drop_policy = UV_SERIAL_REJECT;
+    a.local_node_id = 10;
+    b.local_node_id = 20;
+    a.add(&serial);
+    a.add(&sink);
+    b.add(&tb);
+    int writable = 0;
+    a.on_writable = [&writable](UAVTransport* transport, UAVPriority priority) { writable++; };
+    int received = 0;
+    b.subscribe(3000, dtname_blob, [&received](UAVNodeID node_id, UAVInStream& in) { received++; });
+    UAVDatatypeHash datatype = UAVNode::datatypehash_P(dtname_blob);
+    uint8_t payload[16] = { 0 };
+    completed = went_out = gave_up = 0;
+    // the serial transport (bit 0) queues, the sink (bit 1) sends at once
+    for(int i=0; i<depth; i++) {
+        UAVSendResult result = a.publish(3000, datatype, UAVTransfer::PriorityNominal, payload, sizeof(payload), complete);
+        CHECK( (result.queued==1) && (result.sent==2) && (result.rejected==0) && (result.dropped==0) );
+        CHECK(result);
+    }
+    CHECK(!a.writable(UAVTransfer::PriorityNominal));
+    // full, so the serial transport refuses the next one. the sink still took it.
+    UAVSendResult result = a.publish(3000, datatype, UAVTransfer::PriorityNominal, payload, sizeof(payload), complete);
+    CHECK( (result.queued==0) && (result.rejected==1) && (result.sent==2) );
+    // the rejected one is done, it went out on the sink but not the serial link
+    CHECK( (completed==1) && (went_out==1) && (gave_up==1) );
+    CHECK(writable==0);
+    // the loop writes the queue out and owes one on_writable
+    for(unsigned long t=1; t<5; t++) {
+        a.loop(t, 1);
+        b.loop(t, 1);
+    }
+    CHECK(writable==1);
+    CHECK(a.writable(UAVTransfer::PriorityNominal));
+    CHECK(received==depth);
+    CHECK( (completed==depth+1) && (went_out==depth+1) && (gave_up==1) );
+    // publishes in a batch only reach the transports when it ends
+    {
+        UAVPublishBatch batch(a);
+        UAVSendResult held = a.publish(3000, datatype, UAVTransfer::PriorityNominal, payload, sizeof(payload));
+        CHECK( (held.queued | held.sent | held.dropped | held.rejected) == 0 );
+    }
+    a.remove(&serial);
+    a.remove(&sink);
+    b.remove(&tb);
+}
+
+static void dropped() {
+    // no transports at all
+    UAVNode node;
+    node.local_node_id = 10;
+    completed = went_out = gave_up = 0;
+    uint8_t payload[4] = { 0 };
+    UAVSendResult result = node.publish(3000, 0x1234, UAVTransfer::PriorityNominal, payload, sizeof(payload), complete);
+    CHECK(!result);
+    CHECK( (completed==1) && (went_out==0) );
+}
+
+int main() {
+    statuses();
+    dropped();
+    return test_done("backpressure");
+}
@@ -0,0 +1,97 @@
+/*
+    Per loop i/o budgets on a serial transport. A port that never runs dry must not keep the loop reading,
+    a big transfer goes out write_budget bytes a pass, and time_budget cuts a pass short on a slow port.
+    Passes that stop with work left over are counted as throttled, and the node times every poll.
+*/
+#include "test.h"
+
+// always has more to read, and takes everything written. reads can be made slow.
+class FloodPort : public UAVSerialPort {
+    public:
+        uint64_t read_bytes = 0;
+        uint64_t written = 0;
+        uint32_t reads = 0;
+        uint32_t delay_us = 0;
+        void read(uint8_t* buffer, int count) override {
+            // bytes outside any frame
+            memset(buffer, 0x55, count);
+            read_bytes += count;
+            reads++;
+            uint32_t start = micros();
+            while( (uint32_t)(micros() - start) < delay_us ) { }
+        }
+        void write(uint8_t* buffer, int count) override { written += count; }
+        void flush() override { }
+        int readCount() override { return 1<<20; }
+        int writeCount() override { return 1<<20; }
+};
+
+static void reads() {
+    UAVNode node;
+    FloodPort port;
+    SerialTransport transport(port);
+    node.add(&transport);
+    node.loop(1, 1);
+    CHECK(port.read_bytes==(uint64_t)transport.read_budget);
+    CHECK(transport.throttled==1);
+    transport.read_budget = 300;
+    port.read_bytes = 0;
+    node.loop(2, 1);
+    CHECK(port.read_bytes==300);
+    CHECK(transport.throttled==2);
+    CHECK(transport.oob_bytes==transport.rx_bytes);
+    // the node timed both polls
+    CHECK(transport.polls==2);
+    printf("  a flooded port, worst pass %u us\n", transport.busy_max);
+    node.remove(&transport);
+}
+
+static void writes() {
+    UAVNode node;
+    std::deque<uint8_t> in, out;
+    BenchPipe pipe(&in, &out);
+    SerialTransport transport(pipe);
+    node.local_node_id = 10;
+    node.add(&transport);
+    transport.write_budget = 1000;
+    static uint8_t payload[8000] = { 0 };
+    node.publish(3000, 0x1234, UAVTransfer::PriorityNominal, payload, sizeof(payload));
+    int passes = 0;
+    uint64_t before = 0;
+    bool bounded = true;
+    while( (transport.queued(UAVTransfer::PriorityNominal)>0) || (passes==0) || (pipe.written!=before) ) {
+        before = pipe.written;
+        node.loop(++passes, 1);
+        bounded &= (pipe.written - before <= 1000);
+        if(passes>100) break;
+    }
+    CHECK(bounded);
+    CHECK(pipe.written >= sizeof(payload));
+    // every pass but the last two (the one that finished it and the idle one after) stopped with bytes left
+    CHECK(passes >= (int)(sizeof(payload)/1000));
+    CHECK(transport.throttled==(uint32_t)passes-2);
+    node.remove(&transport);
+}
+
+static void time_budget() {
+    UAVNode node;
+    FloodPort port;
+    SerialTransport transport(port);
+    node.add(&transport);
+    transport.read_budget = 1<<20;
+    transport.time_budget = 500;
+    port.delay_us = 200;
+    node.loop(1, 1);
+    // the budget is checked after each read, so a pass ends on the read that crosses it, the third at the latest
+    CHECK( (port.reads>=1) && (port.reads<=3) );
+    CHECK(transport.throttled==1);
+    CHECK(transport.busy_max>=500);
+    node.remove(&transport);
+}
+
+int main() {
+    reads();
+    writes();
+    time_budget();
+    return test_done("budgets");
+}
@@ -0,0 +1,94 @@
+/*
+    Compact frame negotiation on a point-to-point serial link, as node 20 at the other end restarts.
+    Hellos back off and stop when they go unanswered, a peer that falls back to version 0 gets version 0 again,
+    and a peer that comes back under a new node id is taken as the only one on the link once the old one has gone quiet.
+*/
+#include "test.h"
+#include "apps/heartbeat.h"
+
+class Link {
+    public:
+        BenchLink link;
+        HeartbeatApp ha, hb;
+        unsigned long t = 0;
+        // bytes 10 wrote per heartbeat, over a heartbeat each way once a simulated second
+        double heartbeats(int seconds, UAVNode& b) {
+            uint64_t written = link.pa.written;
+            for(int i=0; i<seconds; i++) {
+                ha.send(link.a);
+                hb.send(b);
+                t += 1000;
+                for(int r=0; r<4; r++) {
+                    link.a.loop(t, 1);
+                    b.loop(t, 1);
+                }
+            }
+            return (double)(link.pa.written - written) / seconds;
+        }
+};
+
+// a heartbeat is about 45 bytes on the wire as version 0 and 22 compact. the uptime in it comes from the host clock,
+// so now and then a byte of it needs escaping, and the hellos are counted rather than inferred from the sizes.
+static const double v0 = 44.0;
+static const double compact = 30.0;
+
+static void unanswered() {
+    Link l;
+    l.link.tb.compact = UV_SERIAL_COMPACT_OFF;
+    // the first hello goes at once, then after 1, 2 and 4 s, and no more
+    l.heartbeats(4, l.link.b);
+    uint32_t early = l.link.ta.hellos;
+    double late = l.heartbeats(100, l.link.b);
+    printf("  unanswered hellos    %u in the first 4 s, %u in all, %5.1f bytes per heartbeat\n", early, l.link.ta.hellos, late);
+    CHECK(early==3);
+    CHECK(l.link.ta.hellos==UV_SERIAL_HELLO_TRIES);
+    CHECK(late > v0);
+}
+
+static void fallback() {
+    Link l;
+    double negotiated = l.heartbeats(5, l.link.b);
+    uint32_t hellos = l.link.ta.hellos;
+    // node 20 restarts into firmware that doesn't send compact frames
+    SerialTransport old(l.link.pb);
+    old.compact = UV_SERIAL_COMPACT_OFF;
+    l.link.b.remove(&l.link.tb);
+    l.link.b.add(&old);
+    l.heartbeats(10, l.link.b);
+    double after = l.heartbeats(20, l.link.b);
+    printf("  peer back to v0      %5.1f bytes per heartbeat negotiated, %5.1f after, %u hellos offered again\n",
+        negotiated, after, l.link.ta.hellos - hellos);
+    CHECK(negotiated < compact);
+    CHECK(after > v0);
+    CHECK(l.link.ta.hellos - hellos == UV_SERIAL_HELLO_TRIES);
+    l.link.b.remove(&old);
+}
+
+static void new_node_id() {
+    Link l;
+    double negotiated = l.heartbeats(5, l.link.b);
+    // node 20 restarts as node 21, so for a while it looks like two nodes share the link
+    UAVNode c;
+    c.local_node_id = 21;
+    SerialTransport tc(l.link.pb);
+    l.link.b.remove(&l.link.tb);
+    c.add(&tc);
+    // 10 doesn't hear node 21 until after its first heartbeat has gone out compact
+    l.heartbeats(2, c);
+    double shared = l.heartbeats(UV_SERIAL_PEER_TIMEOUT/1000 - 4, c);
+    l.heartbeats(5, c);
+    double again = l.heartbeats(10, c);
+    printf("  peer as a new node   %5.1f bytes per heartbeat negotiated, %5.1f while shared, %5.1f after %d s\n",
+        negotiated, shared, again, UV_SERIAL_PEER_TIMEOUT/1000);
+    CHECK(negotiated < compact);
+    CHECK(shared > v0);
+    CHECK(again < compact);
+    c.remove(&tc);
+}
+
+int main() {
+    unanswered();
+    fallback();
+    new_node_id();
+    return test_done("compact");
+}
@@ -0,0 +1,215 @@
+/*
+    Payload compression: UAVCompressor round trips and malformed input, then compressed subjects between two nodes.
+    Every buffer has guard bytes after it, which must come through untouched. Payloads go from empty to past
+    UV_COMPRESS_MAX_SIZE, around the threshold, and as text-like, constant and random bytes.
+*/
+#include "test.h"
+#include <stdlib.h>
+
+static const char dtname_blob[] PROGMEM = "test.compress.Blob.1.0";
+static const char dtname_plain[] PROGMEM = "test.compress.Plain.1.0";
+static const int guard = 32;
+static uint16_t table[UV_COMPRESS_HASH_SIZE];
+
+// repetitive like a register dump, all one byte, or random
+static void fill(uint8_t* data, int size, int kind) {
+    static const char words[] = "voltage current temperature status ok fault ";
+    for(int i=0; i<size; i++) {
+        switch(kind) {
+            case 0: data[i] = words[(i*5/7) % (sizeof(words)-1)]; break;
+            case 1: data[i] = 0x42; break;
+            default: data[i] = rand(); break;
+        }
+    }
+}
+
+// a buffer of size bytes with guard bytes after it
+class Guarded {
+    public:
+        std::vector<uint8_t> bytes;
+        Guarded(int size) : bytes(size + guard, 0xA5) { }
+        uint8_t* data() { return bytes.data(); }
+        bool intact(int size) {
+            for(int i=size; i<size+guard; i++) if(bytes[i]!=0xA5) return false;
+            return true;
+        }
+};
+
+static void round_trips() {
+    int sizes[] = { 0, 1, 2, 3, 4, 31, 32, 33, UV_COMPRESS_THRESHOLD-1, UV_COMPRESS_THRESHOLD, UV_COMPRESS_THRESHOLD+1, 264, 265, 1000,
+        UV_COMPRESS_MAX_SIZE-1, UV_COMPRESS_MAX_SIZE, UV_COMPRESS_MAX_SIZE+1, 9000 };
+    int trips = 0, tight = 0;
+    for(int kind=0; kind<3; kind++) {
+        for(int size : sizes) {
+            std::vector<uint8_t> in(size);
+            fill(in.data(), size, kind);
+            // as much room as the node gives it, and plenty
+            for(int capacity : { size - UV_COMPRESS_HEADER_SIZE, 2*size + 16 }) {
+                if(capacity<0) continue;
+                Guarded packed(capacity);
+                int n = UAVCompressor::compress(in.data(), size, packed.data(), capacity, table);
+                CHECK( (n>=0) && (n<=capacity) );
+                CHECK(packed.intact(capacity));
+                if(n==0) continue;
+                // expands to exactly what went in, and not with a byte less room
+                Guarded out(size);
+                CHECK(UAVCompressor::expand(packed.data(), n, out.data(), size)==size);
+                CHECK(memcmp(out.data(), in.data(), size)==0);
+                CHECK(out.intact(size));
+                if(size>0) {
+                    Guarded short_out(size-1);
+                    CHECK(UAVCompressor::expand(packed.data(), n, short_out.data(), size-1)==-1);
+                    CHECK(short_out.intact(size-1));
+                }
+                trips++;
+            }
+            // every capacity below what it needs gives up cleanly
+            if(size<=1000) {
+                int need = UAVCompressor::compress(in.data(), size, Guarded(2*size+16).data(), 2*size+16, table);
+                for(int capacity=0; capacity<need; capacity++) {
+                    Guarded packed(capacity);
+                    CHECK(UAVCompressor::compress(in.data(), size, packed.data(), capacity, table)==0);
+                    CHECK(packed.intact(capacity));
+                    tight++;
+                }
+            }
+        }
+    }
+    printf("  %d round trips, %d compressions into too little room\n", trips, tight);
+}
+
+static void malformed() {
+    uint8_t in[1000];
+    fill(in, sizeof(in), 0);
+    uint8_t packed[2048];
+    int n = UAVCompressor::compress(in, sizeof(in), packed, sizeof(packed), table);
+    CHECK(n>0);
+    // every truncation expands to less than it should, or fails, and stays in bounds
+    int failed = 0;
+    for(int cut=0; cut<n; cut++) {
+        Guarded out(sizeof(in));
+        int m = UAVCompressor::expand(packed, cut, out.data(), sizeof(in));
+        CHECK(m < (int)sizeof(in));
+        CHECK(out.intact(sizeof(in)));
+        if(m<0) failed++;
+    }
+    CHECK(failed>0);
+    // back references to before the start
+    uint8_t before[][4] = {
+        { 0x20, 0x00 },                     // 3 bytes from 1 back, with nothing written
+        { 0x00, 'a', 0x20, 0x01 },          // 3 bytes from 2 back, with 1 written
+        { 0x00, 'a', 0x3F, 0xFF },          // the furthest an offset goes
+    };
+    int sizes[] = { 2, 4, 4 };
+    for(int i=0; i<3; i++) {
+        Guarded out(64);
+        CHECK(UAVCompressor::expand(before[i], sizes[i], out.data(), 64)==-1);
+        CHECK(out.intact(64));
+    }
+    // a long match or literal run that runs off the end of the input
+    uint8_t cut_long[] = { 0x00, 'a', 0xE0 };
+    uint8_t cut_literal[] = { 0x1F, 'a', 'b' };
+    Guarded out(64);
+    CHECK(UAVCompressor::expand(cut_long, sizeof(cut_long), out.data(), 64)==-1);
+    CHECK(UAVCompressor::expand(cut_literal, sizeof(cut_literal), out.data(), 64)==-1);
+    CHECK(out.intact(64));
+    // random garbage never writes past the end
+    for(int i=0; i<2000; i++) {
+        uint8_t junk[64];
+        fill(junk, sizeof(junk), 2);
+        Guarded out(128);
+        int m = UAVCompressor::expand(junk, sizeof(junk), out.data(), 128);
+        CHECK(m<=128);
+        CHECK(out.intact(128));
+    }
+}
+
+// compressed subjects between two nodes
+static void nodes() {
+    BenchLink link;
+    link.a.compress_subject(3000, dtname_blob);
+    link.b.compress_subject(3000, dtname_blob);
+    // the receiver also takes compressed payloads on a port the sender doesn't compress, so it can be handed anything
+    link.b.compress_subject(3001, dtname_plain);
+    std::vector<uint8_t> last;
+    int received = 0;
+    auto listener = [&](UAVNodeID node_id, UAVInStream& in) {
+        last.resize(in.input_size);
+        in.input_memcpy(last.data(), last.size());
+        received++;
+    };
+    link.b.subscribe(3000, dtname_blob, listener);
+    link.b.subscribe(3001, dtname_plain, listener);
+    UAVDatatypeHash blob = UAVNode::datatypehash_P(dtname_blob);
+    UAVDatatypeHash plain = UAVNode::datatypehash_P(dtname_plain);
+    unsigned long t = 0;
+    int sizes[] = { 0, 1, UV_COMPRESS_THRESHOLD-1, UV_COMPRESS_THRESHOLD, UV_COMPRESS_THRESHOLD+1, 1000,
+        UV_COMPRESS_MAX_SIZE-1, UV_COMPRESS_MAX_SIZE, UV_COMPRESS_MAX_SIZE+1, 6000 };
+    int sent = 0;
+    for(int kind=0; kind<3; kind++) {
+        for(int size : sizes) {
+            std::vector<uint8_t> payload(size);
+            fill(payload.data(), size, kind);
+            link.a.publish(3000, blob, UAVTransfer::PriorityNominal, payload.data(), size);
+            sent++;
+            for(int i=0; i<40; i++) link.pump(++t);
+            CHECK(received==sent);
+            CHECK(last==payload);
+        }
+    }
+    UAVNodePortInfo* tx = link.a.ports.find(3000);
+    UAVNodePortInfo* rx = link.b.ports.find(3000);
+    CHECK( (tx!=nullptr) && (rx!=nullptr) );
+    CHECK(rx->stats_errored==0);
+    // text-like payloads from the threshold to the limit went out smaller
+    CHECK(tx->stats_compress_out < tx->stats_compress_in);
+    printf("  %d payloads over a compressed subject, %llu bytes in %llu out\n", sent,
+        (unsigned long long)tx->stats_compress_in, (unsigned long long)tx->stats_compress_out);
+    // malformed payloads are counted as errors and never reach the listener
+    UAVNodePortInfo* info = link.b.ports.find(3001);
+    CHECK(info!=nullptr);
+    uint8_t valid[256];
+    uint8_t text[200];
+    fill(text, sizeof(text), 0);
+    valid[0] = UV_COMPRESS_LZ;
+    valid[1] = sizeof(text);
+    valid[2] = 0;
+    int n = UAVCompressor::compress(text, sizeof(text), &valid[UV_COMPRESS_HEADER_SIZE], sizeof(valid)-UV_COMPRESS_HEADER_SIZE, table);
+    CHECK(n>0);
+    typedef struct { const char* what; std::vector<uint8_t> bytes; } Bad;
+    std::vector<Bad> bad = {
+        { "no header", { } },
+        { "short header", { UV_COMPRESS_LZ, 10 } },
+        { "unknown method", { 7, 10, 0, 0x00, 'a' } },
+        { "over-long declared size", { UV_COMPRESS_LZ, (uint8_t)((UV_COMPRESS_MAX_SIZE+1)&0xFF), (uint8_t)((UV_COMPRESS_MAX_SIZE+1)>>8), 0x00, 'a' } },
+        { "largest declared size", { UV_COMPRESS_LZ, 0xFF, 0xFF, 0x00, 'a' } },
+        { "reference before start", { UV_COMPRESS_LZ, 3, 0, 0x20, 0x00 } },
+        { "declared too small", std::vector<uint8_t>(valid, valid+UV_COMPRESS_HEADER_SIZE+n) },
+        { "truncated", std::vector<uint8_t>(valid, valid+UV_COMPRESS_HEADER_SIZE+n/2) },
+    };
+    bad[6].bytes[1] = sizeof(text) - 1;
+    int before = received;
+    uint64_t errored = info->stats_errored;
+    for(auto& b : bad) {
+        link.a.publish(3001, plain, UAVTransfer::PriorityNominal, b.bytes.data(), b.bytes.size());
+        for(int i=0; i<4; i++) link.pump(++t);
+        bool counted = (info->stats_errored == ++errored);
+        if(!counted) printf("  %s was not counted\n", b.what);
+        CHECK(counted);
+        errored = info->stats_errored;
+    }
+    CHECK(received==before);
+    // and the real thing still comes through
+    link.a.publish(3001, plain, UAVTransfer::PriorityNominal, valid, UV_COMPRESS_HEADER_SIZE+n);
+    for(int i=0; i<4; i++) link.pump(++t);
+    CHECK(received==before+1);
+    CHECK( (last.size()==sizeof(text)) && (memcmp(last.data(), text, sizeof(text))==0) );
+}
+
+int main() {
+    srand(1);
+    round_trips();
+    malformed();
+    nodes();
+    return test_done("compress");
+}
@@ -0,0 +1,125 @@
+/*
+    Awaited requests: answered, timed out, failed before the coroutine could suspend, and started with the frame pool empty.
+    Needs C++20, so it builds with -std=gnu++20 against a coroutine.cpp built the same way.
+*/
+#include "test.h"
+
+static const char dtname_echo[] PROGMEM = "test.coroutines.Echo.1.0";
+
+typedef struct {
+    bool started = false;
+    bool done = false;
+    int awaited = 0;
+    bool ok[2] = { false, false };
+    uint32_t value[2] = { 0, 0 };
+    uintptr_t stack[3] = { 0, 0, 0 };   // how deep the stack was on starting and after each request
+} Outcome;
+
+// the frame address of a plain function called from the coroutine body
+static __attribute__((noinline)) uintptr_t stack_depth() {
+    return (uintptr_t)__builtin_frame_address(0);
+}
+
+// awaits one or two requests for the echo service in a row
+static UAVCoroutine echo(UAVNode* node, UAVNodeID node_id, uint32_t timeout_ms, int requests, Outcome* outcome) {
+    outcome->started = true;
+    outcome->stack[0] = stack_depth();
+    for(int i=0; i<requests; i++) {
+        uint32_t value = 100 + i;
+        uint8_t buffer[4];
+        UAVOutStream out(buffer, sizeof(buffer));
+        out << value;
+        auto result = co_await node->request_async<uint32_t>(node_id, 100, 0, UAVTransfer::PriorityNominal, out, timeout_ms);
+        outcome->ok[i] = result.ok;
+        if(result) outcome->value[i] = *result;
+        outcome->awaited++;
+        outcome->stack[outcome->awaited] = stack_depth();
+    }
+    outcome->done = true;
+}
+
+static void serve(UAVNode& node) {
+    node.define_service(100, dtname_echo, [](UAVNode& node, UAVInStream& in, UAVPortReply& reply) {
+        uint32_t value;
+        in >> value;
+        uint8_t buffer[4];
+        UAVOutStream out(buffer, sizeof(buffer));
+        out << (uint32_t)(value + 1);
+        reply(out);
+    });
+}
+
+static void answered() {
+    BenchLink link;
+    serve(link.b);
+    Outcome outcome;
+    echo(&link.a, 20, 100, 2, &outcome);
+    CHECK(outcome.started);
+    CHECK(!outcome.done);
+    CHECK(UAVCoroutinePool::in_use==1);
+    for(unsigned long t=1; (t<50) && !outcome.done; t++) link.pump(t);
+    CHECK(outcome.done);
+    CHECK(outcome.ok[0] && (outcome.value[0]==101));
+    CHECK(outcome.ok[1] && (outcome.value[1]==102));
+    CHECK(UAVCoroutinePool::in_use==0);
+}
+
+static void timed_out() {
+    BenchLink link;
+    Outcome outcome;
+    // nobody is node 30
+    echo(&link.a, 30, 50, 1, &outcome);
+    unsigned long t = 1;
+    for(; t<40; t++) link.pump(t);
+    CHECK(!outcome.done);
+    for(; t<100; t++) link.pump(t);
+    CHECK(outcome.done);
+    CHECK(!outcome.ok[0]);
+    CHECK(UAVCoroutinePool::in_use==0);
+}
+
+static void failed_at_once() {
+    // no transports, so the request fails inside request() and the coroutine never suspends
+    UAVNode node;
+    node.local_node_id = 10;
+    Outcome outcome;
+    UAVCoroutine c = echo(&node, 20, 100, 2, &outcome);
+    CHECK(c.started);
+    CHECK(outcome.done);
+    CHECK(outcome.awaited==2);
+    CHECK(!outcome.ok[0] && !outcome.ok[1]);
+    // it carried on where it was rather than being resumed from inside request(), a level deeper each time
+    CHECK(outcome.stack[1]==outcome.stack[0]);
+    CHECK(outcome.stack[2]==outcome.stack[0]);
+    CHECK(UAVCoroutinePool::in_use==0);
+}
+
+static void pool_exhausted() {
+    BenchLink link;
+    serve(link.b);
+    Outcome outcome[UV_COROUTINE_POOL_SIZE+1];
+    for(int i=0; i<UV_COROUTINE_POOL_SIZE; i++) CHECK(echo(&link.a, 20, 100, 1, &outcome[i]).started);
+    CHECK(UAVCoroutinePool::in_use==UV_COROUTINE_POOL_SIZE);
+    // one too many doesn't run at all
+    uint32_t failed = UAVCoroutinePool::failed;
+    UAVCoroutine extra = echo(&link.a, 20, 100, 1, &outcome[UV_COROUTINE_POOL_SIZE]);
+    CHECK(!extra.started);
+    CHECK(!outcome[UV_COROUTINE_POOL_SIZE].started);
+    CHECK(UAVCoroutinePool::failed==failed+1);
+    for(unsigned long t=1; t<50; t++) link.pump(t);
+    for(int i=0; i<UV_COROUTINE_POOL_SIZE; i++) CHECK(outcome[i].done && outcome[i].ok[0]);
+    CHECK(UAVCoroutinePool::in_use==0);
+    // and the frames can be used again
+    Outcome again;
+    CHECK(echo(&link.a, 20, 100, 1, &again).started);
+    for(unsigned long t=50; t<100; t++) link.pump(t);
+    CHECK(again.done && again.ok[0]);
+}
+
+int main() {
+    answered();
+    timed_out();
+    failed_at_once();
+    pool_exhausted();
+    return test_done("coroutines");
+}
@@ -0,0 +1,93 @@
+/*
+    Serial frames decoded in place, straight from the read buffer, must come out the same as through the copying path.
+    The same recorded stream is parsed in one piece, where whole unescaped frames take the in-place path, and a byte at
+    a time, where every frame is copied. Some payloads need escaping, some frames are corrupted, and a small receive
+    buffer has to turn away frames bigger than it on both paths.
+*/
+#include "test.h"
+
+static const char dtname_blob[] PROGMEM = "test.inplace.Blob.1.0";
+static const int frames = 200;
+
+typedef struct {
+    std::vector<uint32_t> payloads;     // a checksum of each payload received, in order
+    uint32_t rx_frames, crc_errors, frames_rejected;
+} Received;
+
+static uint32_t checksum(UAVInStream& in) {
+    uint32_t sum = in.input_size;
+    uint8_t ch;
+    for(int i=0; i<(int)in.input_size; i++) {
+        in >> ch;
+        sum = sum*31 + ch;
+    }
+    return sum;
+}
+
+// payloads of 8 to 400 bytes, every fourth one full of bytes that need escaping
+static std::vector<uint8_t> record() {
+    UAVDatatypeHash datatype = UAVNode::datatypehash_P(dtname_blob);
+    return bench_capture(frames, [&](UAVNode& node, int i) {
+        uint8_t payload[400];
+        int size = 8 + (i*37)%393;
+        for(int j=0; j<size; j++) payload[j] = (i%4==0) ? ((j%2) ? UV_SERIAL_FRAME_DELIMITER : UV_SERIAL_ESCAPE_PREFIX) : (uint8_t)((j*7+i) & 0x3F);
+        node.publish(3000, datatype, UAVTransfer::PriorityNominal, payload, size);
+    });
+}
+
+static Received parse(std::vector<uint8_t> stream, int chunk, int rx_buffer_size) {
+    std::deque<uint8_t> in, out;
+    BenchPipe pipe(&in, &out);
+    SerialTransport transport(&pipe, false, nullptr, UV_SERIAL_QUEUE_DEPTH, rx_buffer_size);
+    UAVNode node;
+    node.local_node_id = 20;
+    Received r;
+    node.subscribe(3000, dtname_blob, [&r](UAVNodeID node_id, UAVInStream& in) { r.payloads.push_back(checksum(in)); });
+    for(size_t i=0; i<stream.size(); i+=chunk) transport.parse_buffer(&stream[i], min((int)(stream.size()-i), chunk), &node);
+    r.rx_frames = transport.rx_frames;
+    r.crc_errors = transport.crc_errors;
+    r.frames_rejected = transport.frames_rejected;
+    return r;
+}
+
+static void same(const char* what, const Received& whole, const Received& bytes) {
+    printf("  %-22s in place %3zu received %3u crc errors %3u rejected   copied %3zu received %3u crc errors %3u rejected\n", what,
+        whole.payloads.size(), whole.crc_errors, whole.frames_rejected, bytes.payloads.size(), bytes.crc_errors, bytes.frames_rejected);
+    CHECK(whole.payloads==bytes.payloads);
+    CHECK(whole.rx_frames==bytes.rx_frames);
+    CHECK(whole.crc_errors==bytes.crc_errors);
+    CHECK(whole.frames_rejected==bytes.frames_rejected);
+}
+
+int main() {
+    std::vector<uint8_t> stream = record();
+    // clean
+    Received whole = parse(stream, stream.size(), UV_SERIAL_RX_BUFFER_SIZE);
+    Received bytes = parse(stream, 1, UV_SERIAL_RX_BUFFER_SIZE);
+    same("clean", whole, bytes);
+    CHECK(whole.payloads.size()==(size_t)frames);
+    CHECK(whole.crc_errors==0);
+    // a payload byte flipped in every tenth frame. the frames start after a delimiter.
+    std::vector<uint8_t> corrupt = stream;
+    int frame = 0;
+    for(size_t i=1; i<corrupt.size(); i++) {
+        if( (corrupt[i-1]==UV_SERIAL_FRAME_DELIMITER) && (corrupt[i]!=UV_SERIAL_FRAME_DELIMITER) ) {
+            if( (frame%10==5) && (i+UV_SERIAL_HEADER_WITH_CRC_SIZE+4<corrupt.size()) ) corrupt[i+UV_SERIAL_HEADER_WITH_CRC_SIZE+2] ^= 0x01;
+            frame++;
+        }
+    }
+    whole = parse(corrupt, corrupt.size(), UV_SERIAL_RX_BUFFER_SIZE);
+    bytes = parse(corrupt, 1, UV_SERIAL_RX_BUFFER_SIZE);
+    same("corrupted", whole, bytes);
+    CHECK(whole.crc_errors>0);
+    CHECK(whole.payloads.size()==(size_t)frames-whole.crc_errors);
+    // a 128 byte receive buffer takes the small frames and turns the rest away
+    whole = parse(stream, stream.size(), 128);
+    bytes = parse(stream, 1, 128);
+    same("128 byte rx buffer", whole, bytes);
+    int small = 0;
+    for(int i=0; i<frames; i++) if(8 + (i*37)%393 + UV_SERIAL_MIN_FRAME_SIZE <= 128) small++;
+    CHECK(whole.payloads.size()==(size_t)small);
+    CHECK(whole.frames_rejected==(uint32_t)(frames-small));
+    return test_done("inplace");
+}
@@ -0,0 +1,58 @@
+/*
+    The in-memory serial ports: a LoopbackSerialPort and both ends of an SPSCSerialLink keep what fits,
+    count the rest in overruns, and give bytes back in order across the ring's wrap.
+*/
+#include "test.h"
+
+// writes more than the free space, then reads it all back
+template <typename W, typename R>
+static void overrun(W& writer, R& reader, uint32_t& overruns, int size) {
+    uint8_t data[300], back[300];
+    for(int i=0; i<(int)sizeof(data); i++) data[i] = i;
+    CHECK(writer.writeCount()==size);
+    writer.write(data, 100);
+    CHECK(overruns==0);
+    CHECK(reader.readCount()==100);
+    // 200 more, into less room than that
+    writer.write(&data[100], 200);
+    CHECK(overruns==(uint32_t)(300-size));
+    CHECK(writer.writeCount()==0);
+    CHECK(reader.readCount()==size);
+    reader.read(back, size);
+    CHECK(memcmp(back, data, size)==0);
+    CHECK(reader.readCount()==0);
+    CHECK(writer.writeCount()==size);
+}
+
+// many small writes and reads that go round the ring several times
+template <typename W, typename R>
+static void wraps(W& writer, R& reader) {
+    uint8_t next = 0, expect = 0;
+    bool in_order = true;
+    for(int i=0; i<1000; i++) {
+        uint8_t chunk[37];
+        int n = 1 + i%37;
+        for(int j=0; j<n; j++) chunk[j] = next++;
+        writer.write(chunk, n);
+        int m = reader.readCount();
+        reader.read(chunk, m);
+        for(int j=0; j<m; j++) in_order &= (chunk[j]==expect++);
+    }
+    CHECK(in_order);
+    CHECK(next==expect);
+}
+
+int main() {
+    // sizes round up to a power of two
+    LoopbackSerialPort loopback(128);
+    overrun(loopback, loopback, loopback.overruns, 128);
+    wraps(loopback, loopback);
+    CHECK(loopback.overruns==(uint32_t)(300-128));
+    SPSCSerialLink link(128);
+    overrun(link.a, link.b, link.a.overruns, 128);
+    overrun(link.b, link.a, link.b.overruns, 128);
+    wraps(link.a, link.b);
+    LoopbackSerialPort odd(100);
+    CHECK(odd.writeCount()==128);
+    return test_done("loopback");
+}
@@ -0,0 +1,24 @@
+#ifndef LIBUAVESP_TEST_H_INCLUDED
+#define LIBUAVESP_TEST_H_INCLUDED
+
+/*
+    Shared bits for the host tests: a check that reports where it failed and carries on, and the benchmark link helpers.
+    Build and run them with `make test` in extras.
+*/
+#include "../benchmarks/bench.h"
+
+static int test_checks = 0;
+static int test_failures = 0;
+
+#define CHECK(cond) do { \
+    test_checks++; \
+    if(!(cond)) { printf("%s:%d: failed: %s\n", __FILE__, __LINE__, #cond); test_failures++; } \
+} while(0)
+
+// prints the tally and gives the exit code
+inline int test_done(const char* name) {
+    printf("  %-12s %4d checks  %d failed\n", name, test_checks, test_failures);
+    return test_failures==0 ? 0 : 1;
+}
+
+#endif
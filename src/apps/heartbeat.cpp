@@ -10,8 +10,8 @@ void HeartbeatApp::set_status(uint8_t health, uint8_t mode, uint32_t vendor) {
 void HeartbeatApp::send(UAVNode& node) {
     // send the next heartbeat message
     _message.uptime = millis() / (unsigned long)1000;
-    uint8_t payload[16];
-    UAVOutStream stream(payload,16);
+    // serialize straight into the outgoing transfer
+    auto stream = node.reserve(16);
     stream << _message;
     node.publish(
         subjectid_uavcan_node_Heartbeat_1_0, 
@@ -29,7 +29,6 @@ void HeartbeatApp::start(UAVNode& node) {
     send(node);
     // change to operational mode for next heartbeat
     set_status(HEARTBEAT_HEALTH_NOMINAL, HEARTBEAT_MODE_OPERATIONAL, 0x4241);
-    _timer = HEARTBEAT_DELAY;
 }
 
 void HeartbeatApp::stop(UAVNode& node) {
@@ -39,12 +38,6 @@ void HeartbeatApp::stop(UAVNode& node) {
 }
 
 void HeartbeatApp::loop(UAVNode& node, unsigned long t,int dt) {
-    long delta = t - _timer;
-    if(delta>0) {
-        // send heartbeat
-        send(node);
-        // update timer to next second-aligned step
-        unsigned long skip = delta / HEARTBEAT_DELAY;
-        _timer += (skip+1)*HEARTBEAT_DELAY;
-    }
+    // the node wakes us once a second, on the second
+    send(node);
 }
@@ -56,8 +56,8 @@ class HeartbeatMessage {
 class HeartbeatApp : public UAVTask  {
     protected:
         HeartbeatMessage _message;
-        unsigned long    _timer = 0;
     public:
+        HeartbeatApp() { period = HEARTBEAT_DELAY; }
         // application setup
         static void app_v1(UAVNode *node) {
             // we will be sending messages
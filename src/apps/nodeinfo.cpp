@@ -1,6 +1,6 @@
 #include "nodeinfo.h"
 
-void NodeinfoApp::service_GetInfo_v1(UAVNode& node, UAVInStream& in, UAVPortReply reply) {
+void NodeinfoApp::service_GetInfo_v1(UAVNode& node, UAVInStream& in, UAVPortReply& reply) {
     // prepare default reply
     NodeGetInfoReply r;
     r.protocol_version.major = 1;
@@ -40,7 +40,7 @@ void NodeinfoApp::service_GetInfo_v1(UAVNode& node, UAVInStream& in, UAVPortRepl
     reply(out);
 }
 
-void NodeinfoApp::service_ExecuteCommand_v1(UAVNode& node, UAVInStream& in, UAVPortReply reply) {
+void NodeinfoApp::service_ExecuteCommand_v1(UAVNode& node, UAVInStream& in, UAVPortReply& reply) {
     // prepare default reply
     NodeExecuteCommandReply r;
     r.status = 0; // success status. all the non-zero codes are errors
@@ -92,12 +92,12 @@ void NodeinfoApp::GetInfo(UAVNode* node, uint32_t node_id, std::function<void(No
         dthash_uavcan_node_GetInfo_1_0, 
         UAVTransfer::PriorityNominal, 
         nullptr, 0, 
-        [fn](UAVInStream& in) {
+        [fn](UAVInStream* in) {
             if(fn==nullptr) return; // no function, no worries
-            if(&in==nullptr) return fn(nullptr); // null data, likely from timeout
+            if(in==nullptr) return fn(nullptr); // null data, from timeout
             // parse our reply object and then callback
             NodeGetInfoReply info;
-            in >> info;
+            *in >> info;
             fn(&info);
         }
     );
@@ -119,12 +119,12 @@ void NodeinfoApp::ExecuteCommand(UAVNode* node, uint32_t node_id, uint16_t comma
         dthash_uavcan_node_ExecuteCommand_1_0, 
         UAVTransfer::PriorityNominal, 
         out, 
-        [fn](UAVInStream& in) {
+        [fn](UAVInStream* in) {
             if(fn==nullptr) return; // no function, no worries
-            if(&in==nullptr) return fn(nullptr); // null data, likely from timeout
+            if(in==nullptr) return fn(nullptr); // null data, from timeout
             // parse our reply object and then callback
             NodeExecuteCommandReply reply;
-            in >> reply;
+            *in >> reply;
             fn(&reply);
         }
     );
@@ -150,8 +150,8 @@ class NodeGetInfoReply {
 class NodeinfoApp {
     public:
         // define the port functions for this app
-        static void service_GetInfo_v1(UAVNode& node, UAVInStream& in, UAVPortReply reply);
-        static void service_ExecuteCommand_v1(UAVNode& node, UAVInStream& in, UAVPortReply reply);
+        static void service_GetInfo_v1(UAVNode& node, UAVInStream& in, UAVPortReply& reply);
+        static void service_ExecuteCommand_v1(UAVNode& node, UAVInStream& in, UAVPortReply& reply);
         // start app on node
         static void app_v1(UAVNode *node);
         // request API
@@ -1 +1,92 @@
 #include "portinfo.h"
+
+UAVNodePortInfo* PortinfoApp::port(UAVNode& node, PortID& id) {
+    UAVPortID port_id;
+    if(id.is_subject()) {
+        port_id = id.as_subject();
+    } else if(id.is_service()) {
+        port_id = id.as_service() | 0x8000;
+    } else {
+        return nullptr;
+    }
+    // service calls are rare, the port map is fine here
+    return node.ports.find(port_id);
+}
+
+void PortinfoApp::service_GetInfo_v1(UAVNode& node, UAVInStream& in, UAVPortReply& reply) {
+    // decode the request
+    PortGetInfoRequest request;
+    in >> request;
+    // prepare the reply, unknown ports are neither input nor output
+    PortGetInfoReply r;
+    r.is_input = false;
+    r.is_output = false;
+    r.data_type_version.major = 0;
+    r.data_type_version.minor = 0;
+    UAVNodePortInfo* info = port(node, request.port_id);
+    if(info!=nullptr) {
+        r.is_input = info->is_input;
+        r.is_output = info->is_output;
+        // the full name ends with .major.minor
+        char name[256];
+        strncpy_P(name, info->dtf_name, 255);
+        name[255] = 0;
+        int major = 0, minor = 0;
+        char* dot = strrchr(name, '.');
+        if(dot!=nullptr) {
+            minor = atoi(dot+1);
+            *dot = 0;
+            dot = strrchr(name, '.');
+            if(dot!=nullptr) {
+                major = atoi(dot+1);
+                *dot = 0;
+            }
+        }
+        r.data_type_full_name.assign(name);
+        r.data_type_version.major = major;
+        r.data_type_version.minor = minor;
+    }
+    // send reply
+    uint8_t buffer[260];
+    UAVOutStream out(buffer,260);
+    out << r;
+    reply(out);
+}
+
+void PortinfoApp::service_GetStatistics_v1(UAVNode& node, UAVInStream& in, UAVPortReply& reply) {
+    // decode the request
+    PortGetStatisticsRequest request;
+    in >> request;
+    // copy out the counters the node keeps for the port, or zeros
+    PortGetStatisticsReply r;
+    r.statistics.num_emitted = 0;
+    r.statistics.num_received = 0;
+    r.statistics.num_errored = 0;
+    UAVNodePortInfo* info = port(node, request.port_id);
+    if(info!=nullptr) {
+        r.statistics.num_emitted = info->stats_emitted;
+        r.statistics.num_received = info->stats_recieved;
+        r.statistics.num_errored = info->stats_errored;
+    }
+    // send reply
+    uint8_t buffer[16];
+    UAVOutStream out(buffer,16);
+    out << r;
+    reply(out);
+}
+
+// define the port and functions for this app
+void PortinfoApp::app_v1(UAVNode *node) {
+    // port.GetInfo service call
+    node->define_service( 
+        serviceid_uavcan_port_GetInfo_1_0,
+        dtname_uavcan_port_GetInfo_1_0,
+        service_GetInfo_v1
+    );
+    // port.GetStatistics service call
+    node->define_service( 
+        serviceid_uavcan_port_GetStatistics_1_0,
+        dtname_uavcan_port_GetStatistics_1_0,
+        service_GetStatistics_v1
+    );
+}
@@ -85,7 +85,7 @@ class PortGetInfoReply {
 
 static const     char dtname_uavcan_port_GetStatistics_1_0[] PROGMEM = "uavcan.port.GetStatistics.1.0";
 static const uint64_t dthash_uavcan_port_GetStatistics_1_0 = UAVNode::datatypehash_P(dtname_uavcan_port_GetStatistics_1_0);
-static const uint16_t serviceid_uavcan_port_GetStatistics_1_0 = 432;
+static const uint16_t serviceid_uavcan_port_GetStatistics_1_0 = 433;
 class PortGetStatisticsRequest {
     public:
         PortID port_id;
@@ -109,5 +109,16 @@ class PortGetStatisticsReply {
         }
 };
 
+class PortinfoApp {
+    public:
+        // define the port functions for this app
+        static void service_GetInfo_v1(UAVNode& node, UAVInStream& in, UAVPortReply& reply);
+        static void service_GetStatistics_v1(UAVNode& node, UAVInStream& in, UAVPortReply& reply);
+        // start app on node
+        static void app_v1(UAVNode *node);
+        // find the local port a PortID refers to
+        static UAVNodePortInfo* port(UAVNode& node, PortID& id);
+};
+
 
 #endif
\ No newline at end of file
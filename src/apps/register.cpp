@@ -9,13 +9,13 @@ void RegisterApp::app_v1(UAVNode *node, RegisterList *registers) {
     node->define_service( 
         serviceid_uavcan_register_Access_1_0, 
         dtname_uavcan_register_Access_1_0, 
-        [&registers](UAVNode& node, UAVInStream& in, UAVPortReply reply) {
+        [&registers](UAVNode& node, UAVInStream& in, UAVPortReply& reply) {
         });
     // register.List service call
     node->define_service(
         serviceid_uavcan_register_List_1_0, 
         dtname_uavcan_register_List_1_0, 
-        [&registers](UAVNode& node, UAVInStream& in, UAVPortReply reply) {
+        [&registers](UAVNode& node, UAVInStream& in, UAVPortReply& reply) {
             
         });
     
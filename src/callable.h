@@ -0,0 +1,90 @@
+#ifndef LIBUAVESP_CALLABLE_H_INCLUDED
+#define LIBUAVESP_CALLABLE_H_INCLUDED
+
+#include <stddef.h>
+#include <new>
+#include <utility>
+#include <type_traits>
+
+// default inline capture space for node callbacks. enough for a few pointers, or one std::function.
+#ifndef UV_CALLABLE_SIZE
+#define UV_CALLABLE_SIZE (4*sizeof(void*))
+#endif
+
+/*
+    Move-only callable wrapper with fixed inline storage.
+    Works like std::function for lambdas and function pointers, but the target always lives inside the object,
+    so constructing, moving and calling one never touches the heap. A target that does not fit is a compile error.
+*/
+template <typename Signature, size_t Capacity = UV_CALLABLE_SIZE>
+class UAVCallable;
+
+template <typename R, typename... Args, size_t Capacity>
+class UAVCallable<R(Args...), Capacity> {
+    protected:
+        typedef R (*Invoker)(void* target, Args... args);
+        // move-construct the target from src into dst then destroy src. with no dst, just destroy src.
+        typedef void (*Manager)(void* dst, void* src);
+        typename std::aligned_storage<Capacity>::type _storage;
+        Invoker _invoke = nullptr;
+        Manager _manage = nullptr;
+        template <typename T>
+        static R invoke(void* target, Args... args) {
+            return (*static_cast<T*>(target))(std::forward<Args>(args)...);
+        }
+        template <typename T>
+        static void manage(void* dst, void* src) {
+            if(dst!=nullptr) new(dst) T(std::move(*static_cast<T*>(src)));
+            static_cast<T*>(src)->~T();
+        }
+        void reset() {
+            if(_manage!=nullptr) _manage(nullptr, &_storage);
+            _invoke = nullptr;
+            _manage = nullptr;
+        }
+        void take(UAVCallable& other) {
+            if(other._manage!=nullptr) other._manage(&_storage, &other._storage);
+            _invoke = other._invoke;
+            _manage = other._manage;
+            other._invoke = nullptr;
+            other._manage = nullptr;
+        }
+    public:
+        UAVCallable() { }
+        UAVCallable(std::nullptr_t) { }
+        template <typename F, typename = typename std::enable_if<!std::is_same<typename std::decay<F>::type, UAVCallable>::value>::type>
+        UAVCallable(F&& f) {
+            typedef typename std::decay<F>::type T;
+            static_assert(sizeof(T) <= Capacity, "callable target is too large for UAVCallable inline storage");
+            static_assert(alignof(T) <= alignof(decltype(_storage)), "callable target alignment is too strict for UAVCallable");
+            new(&_storage) T(std::forward<F>(f));
+            _invoke = &invoke<T>;
+            _manage = &manage<T>;
+        }
+        UAVCallable(UAVCallable&& other) { take(other); }
+        UAVCallable(const UAVCallable&) = delete;
+        ~UAVCallable() { reset(); }
+        UAVCallable& operator=(UAVCallable&& other) {
+            if(this!=&other) {
+                reset();
+                take(other);
+            }
+            return *this;
+        }
+        UAVCallable& operator=(std::nullptr_t) {
+            reset();
+            return *this;
+        }
+        UAVCallable& operator=(const UAVCallable&) = delete;
+        // call the target. like std::function, calling an empty wrapper is not allowed.
+        R operator()(Args... args) const {
+            return _invoke((void*)&_storage, std::forward<Args>(args)...);
+        }
+        explicit operator bool() const { return _invoke!=nullptr; }
+        friend bool operator==(const UAVCallable& f, std::nullptr_t) { return f._invoke==nullptr; }
+        friend bool operator!=(const UAVCallable& f, std::nullptr_t) { return f._invoke!=nullptr; }
+        friend bool operator==(std::nullptr_t, const UAVCallable& f) { return f._invoke==nullptr; }
+        friend bool operator!=(std::nullptr_t, const UAVCallable& f) { return f._invoke!=nullptr; }
+};
+
+#endif
@@ -0,0 +1,87 @@
+#include "compress.h"
+#include <string.h>
+
+// hash of the three bytes starting at p
+static inline int uv_compress_hash(const uint8_t* p) {
+    uint32_t v = ((uint32_t)p[0]<<16) | ((uint32_t)p[1]<<8) | p[2];
+    return (v * 2654435761u) >> (32 - UV_COMPRESS_HASH_BITS);
+}
+
+int UAVCompressor::compress(const uint8_t* in, int size, uint8_t* out, int capacity, uint16_t* table) {
+    // table entries are positions plus one, so zero is empty
+    memset(table, 0, UV_COMPRESS_HASH_SIZE * sizeof(uint16_t));
+    int ip = 0;
+    int op = 1;     // room for the first literal control byte
+    int lit = 0;    // length of the literal run being collected
+    while(ip < size) {
+        // worst case is a match and the next control byte
+        if(op + 4 > capacity) return 0;
+        int ref = -1;
+        if(ip + 2 < size) {
+            int h = uv_compress_hash(&in[ip]);
+            ref = table[h] - 1;
+            table[h] = ip + 1;
+        }
+        int off = ip - ref - 1;
+        if( (ref>=0) && (off < 8192) && (in[ref]==in[ip]) && (in[ref+1]==in[ip+1]) && (in[ref+2]==in[ip+2]) ) {
+            // how long is the match?
+            int len = 3;
+            int max = size - ip;
+            if(max > 264) max = 264;
+            while( (len<max) && (in[ref+len]==in[ip+len]) ) len++;
+            // close the literal run, or take back its unused control byte
+            if(lit>0) out[op-lit-1] = lit-1; else op--;
+            ip += len;
+            len -= 2;
+            if(len<7) {
+                out[op++] = (off>>8) | (len<<5);
+            } else {
+                out[op++] = (off>>8) | (7<<5);
+                out[op++] = len - 7;
+            }
+            out[op++] = off;
+            // start the next literal run
+            lit = 0;
+            op++;
+        } else {
+            out[op++] = in[ip++];
+            // literal runs are at most 32 long
+            if(++lit==32) {
+                out[op-lit-1] = lit-1;
+                lit = 0;
+                op++;
+            }
+        }
+    }
+    if(lit>0) out[op-lit-1] = lit-1; else op--;
+    return op;
+}
+
+int UAVCompressor::expand(const uint8_t* in, int size, uint8_t* out, int capacity) {
+    int ip = 0;
+    int op = 0;
+    while(ip < size) {
+        int c = in[ip++];
+        if(c<32) {
+            // literal run
+            int len = c + 1;
+            if( (ip+len > size) || (op+len > capacity) ) return -1;
+            memcpy(&out[op], &in[ip], len);
+            ip += len;
+            op += len;
+        } else {
+            // back reference, which may overlap what it is copying
+            int len = c >> 5;
+            if(len==7) {
+                if(ip >= size) return -1;
+                len += in[ip++];
+            }
+            if(ip >= size) return -1;
+            int ref = op - ((c & 0x1F)<<8) - in[ip++] - 1;
+            len += 2;
+            if( (ref<0) || (op+len > capacity) ) return -1;
+            for(int i=0; i<len; i++) out[op++] = out[ref++];
+        }
+    }
+    return op;
+}
@@ -0,0 +1,38 @@
+#ifndef LIBUAVESP_COMPRESS_H_INCLUDED
+#define LIBUAVESP_COMPRESS_H_INCLUDED
+
+#include <stddef.h>
+#include <stdint.h>
+
+// payloads on compressed ports start with a method byte. lz payloads follow it with their expanded size, 16 bits little-endian.
+#define UV_COMPRESS_NONE        0
+#define UV_COMPRESS_LZ          1
+#define UV_COMPRESS_HEADER_SIZE 3
+// smallest payload worth trying to compress, by default
+#ifndef UV_COMPRESS_THRESHOLD
+#define UV_COMPRESS_THRESHOLD   64
+#endif
+// largest payload compressed, and so the most a receiver ever has to expand. larger ones are sent as they are.
+#ifndef UV_COMPRESS_MAX_SIZE
+#define UV_COMPRESS_MAX_SIZE    4096
+#endif
+// match finder hash table, 2 bytes an entry
+#ifndef UV_COMPRESS_HASH_BITS
+#define UV_COMPRESS_HASH_BITS   8
+#endif
+#define UV_COMPRESS_HASH_SIZE   (1<<UV_COMPRESS_HASH_BITS)
+
+/*
+    LZF style compression. each block is either a literal run (control byte 0-31, then that many plus one bytes)
+    or a back reference (3 bit length, 13 bit offset, with an extra length byte for long matches).
+    Both directions work within the buffers they are given, so memory use is fixed.
+*/
+class UAVCompressor {
+    public:
+        // compress into out. returns the compressed size, or 0 if it wouldn't fit in capacity.
+        static int compress(const uint8_t* in, int size, uint8_t* out, int capacity, uint16_t* table);
+        // expand into out. returns the expanded size, or -1 if the data is corrupt or would overrun capacity.
+        static int expand(const uint8_t* in, int size, uint8_t* out, int capacity);
+};
+
+#endif
@@ -0,0 +1,35 @@
+#include "coroutine.h"
+
+#ifdef UV_COROUTINES
+
+// frame storage and the stack of free block indexes
+static uint64_t uv_coroutine_frames[UV_COROUTINE_POOL_SIZE][UV_COROUTINE_FRAME_SIZE/sizeof(uint64_t)];
+static uint8_t  uv_coroutine_free[UV_COROUTINE_POOL_SIZE];
+static int      uv_coroutine_free_count = -1;
+
+int      UAVCoroutinePool::in_use = 0;
+int      UAVCoroutinePool::high_water = 0;
+uint32_t UAVCoroutinePool::failed = 0;
+
+void* UAVCoroutinePool::allocate(size_t size) {
+    // first use fills the free list
+    if(uv_coroutine_free_count<0) {
+        for(int i=0; i<UV_COROUTINE_POOL_SIZE; i++) uv_coroutine_free[i] = i;
+        uv_coroutine_free_count = UV_COROUTINE_POOL_SIZE;
+    }
+    if( (size > UV_COROUTINE_FRAME_SIZE) || (uv_coroutine_free_count==0) ) {
+        failed++;
+        return nullptr;
+    }
+    in_use++;
+    if(in_use>high_water) high_water = in_use;
+    return uv_coroutine_frames[ uv_coroutine_free[--uv_coroutine_free_count] ];
+}
+
+void UAVCoroutinePool::release(void* frame) {
+    int index = ((uint64_t (*)[UV_COROUTINE_FRAME_SIZE/sizeof(uint64_t)])frame) - uv_coroutine_frames;
+    uv_coroutine_free[uv_coroutine_free_count++] = index;
+    in_use--;
+}
+
+#endif
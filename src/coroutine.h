@@ -0,0 +1,73 @@
+#ifndef LIBUAVESP_COROUTINE_H_INCLUDED
+#define LIBUAVESP_COROUTINE_H_INCLUDED
+
+#include <stddef.h>
+#include <stdint.h>
+#include <utility>
+
+// coroutine support needs a C++20 compiler. the rest of the library builds without it.
+#if defined(__cpp_impl_coroutine) && defined(__has_include)
+#if __has_include(<coroutine>)
+#define UV_COROUTINES
+#endif
+#endif
+
+// result of an awaited request. ok is false when the request timed out.
+template <typename T>
+class UAVResult {
+    public:
+        bool ok = false;
+        T value;
+        explicit operator bool() const { return ok; }
+        T* operator->() { return &value; }
+        T& operator*() { return value; }
+};
+
+#ifdef UV_COROUTINES
+#include <coroutine>
+
+// number and size of preallocated coroutine frames
+#ifndef UV_COROUTINE_POOL_SIZE
+#define UV_COROUTINE_POOL_SIZE  8
+#endif
+#ifndef UV_COROUTINE_FRAME_SIZE
+#define UV_COROUTINE_FRAME_SIZE 512
+#endif
+
+// fixed block allocator for coroutine frames, so starting a coroutine never touches the heap
+class UAVCoroutinePool {
+    public:
+        static int      in_use;
+        static int      high_water;
+        static uint32_t failed;     // frames refused, either too big or the pool was empty
+        static void* allocate(size_t size);
+        static void release(void* frame);
+};
+
+/*
+    Fire-and-forget coroutine type for node code, eg. crawlers that co_await node.request_async().
+    Runs immediately until its first co_await and frees its frame when it finishes.
+    If no frame is available the coroutine does not run at all, and started is false.
+*/
+class UAVCoroutine {
+    public:
+        bool started;
+        explicit UAVCoroutine(bool s) : started(s) { }
+        class promise_type {
+            public:
+                static void* operator new(size_t size) noexcept { return UAVCoroutinePool::allocate(size); }
+                static void operator delete(void* frame, size_t size) noexcept { UAVCoroutinePool::release(frame); }
+                static UAVCoroutine get_return_object_on_allocation_failure() { return UAVCoroutine(false); }
+                UAVCoroutine get_return_object() { return UAVCoroutine(true); }
+                std::suspend_never initial_suspend() noexcept { return {}; }
+                std::suspend_never final_suspend() noexcept { return {}; }
+                void return_void() { }
+                void unhandled_exception() { }
+        };
+};
+
+template <typename T>
+class UAVRequestAwaitable;
+#endif
+
+#endif
@@ -75,6 +75,13 @@ uint32_t crc32c(uint8_t *buf, int len) {
 	return crc ^ 0xffffffff;
 }
 
+uint32_t crc32c_update(uint32_t crc, const uint8_t *buf, int len) {
+	while (len-- > 0) {
+		crc = crc32c_add(crc, *buf++);
+	}
+	return crc;
+}
+
 /*
 uint32_t crc32c_table_flash[256] PROGMEM = {
 	0x00000000L, 0xF26B8303L, 0xE13B70F7L, 0x1350F3F4L,
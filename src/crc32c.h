@@ -12,6 +12,18 @@ extern "C" {
 //uint32_t crc32c_ram(uint8_t *buf, int len);
 uint32_t crc32c(uint8_t *buf, int len);
 
+// incremental crc, for data that arrives a byte at a time.
+// start from CRC32C_INITIAL and add each byte. after a block followed by its own little-endian crc, the register holds CRC32C_RESIDUE.
+#define CRC32C_INITIAL  0xFFFFFFFF
+#define CRC32C_RESIDUE  0xB798B438
+extern uint32_t crc32c_table_ram[256];
+static inline uint32_t crc32c_add(uint32_t crc, uint8_t c) {
+	return (crc>>8) ^ crc32c_table_ram[(crc ^ c) & 0xFF];
+}
+
+// add a block to an incremental crc
+uint32_t crc32c_update(uint32_t crc, const uint8_t *buf, int len);
+
 //void test_crc32();
 
 #ifdef __cplusplus
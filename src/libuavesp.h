@@ -14,6 +14,9 @@
 #include "transports/serial.h"
 #include "transports/udp.h"
 #include "transports/tcp.h"
+#include "transports/posix.h"
+#include "transports/capture.h"
+#include "transports/replay.h"
 #include "primitive.h"
 #include "apps/heartbeat.h"
 #include "apps/nodeinfo.h"
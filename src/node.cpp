@@ -27,31 +27,106 @@ UAVNodePortInfo* UAVPortList::port_claim(uint16_t port_id, PGM_P dtf_name) {
         // no existing entry for this port, create it
         info = new UAVNodePortInfo(port_id,dtf_name);
         list[port_id] = info;
+        // index it for the hot path. if the index is full, find() falls back to the list.
+        UAVNodePortInfo** slot = index.insert(port_id, info->dt_hash);
+        if(slot!=nullptr) *slot = info;
     }
     // return the info
     return info;
 }
 
+UAVNodePortInfo* UAVPortList::find(UAVPortID port_id, UAVDatatypeHash datatype) {
+    UAVNodePortInfo** slot = index.find(port_id, datatype);
+    if(slot!=nullptr) return *slot;
+    // a miss is only final if every port made it into the index
+    if(index.count()==(int)list.size()) return nullptr;
+    UAVNodePortInfo* info = find(port_id);
+    return ( (info!=nullptr) && (info->dt_hash==datatype) ) ? info : nullptr;
+}
+
+UAVNodePortInfo* UAVPortList::find(UAVPortID port_id) {
+    auto it = list.find(port_id);
+    return (it==list.end()) ? nullptr : it->second;
+}
+
+// session transfer counters
+UAVSessionCounters::UAVSessionCounters(int capacity) {
+    // round up to a power of two number of sets
+    int sets = 1;
+    while(sets*UV_NODE_SESSION_WAYS < capacity) sets <<= 1;
+    _set_mask = sets-1;
+    _entries = new Entry[sets*UV_NODE_SESSION_WAYS];
+    for(int i=0; i<sets*UV_NODE_SESSION_WAYS; i++) _entries[i].used = 0;
+}
+
+UAVSessionCounters::~UAVSessionCounters() {
+    delete[] _entries;
+}
+
+UAVTransferID UAVSessionCounters::next(UAVPortID port_id, UAVNodeID node_id) {
+    _clock++;
+    uint32_t stamp = (uint32_t)_clock;
+    if(stamp==0) stamp = 1; // zero marks empty entries
+    // find the set for this session
+    uint32_t h = (((uint32_t)port_id << 16) | node_id) * 0x9E3779B1;
+    Entry* set = &_entries[ ((h >> 16) & _set_mask) * UV_NODE_SESSION_WAYS ];
+    Entry* victim = &set[0];
+    for(int i=0; i<UV_NODE_SESSION_WAYS; i++) {
+        Entry* e = &set[i];
+        if(e->used==0) {
+            // empty way, claim it unless we find the session further along
+            if(victim->used!=0) victim = e;
+            continue;
+        }
+        if( (e->port_id==port_id) && (e->node_id==node_id) ) {
+            e->used = stamp;
+            return e->next++;
+        }
+        // remember the least recently used way
+        if( (victim->used!=0) && ((int32_t)(e->used - victim->used) < 0) ) victim = e;
+    }
+    // not found. start a new counter in the victim way
+    if(victim->used!=0) evictions++;
+    victim->port_id = port_id;
+    victim->node_id = node_id;
+    victim->used = stamp;
+    victim->next = _clock + 1;
+    return _clock;
+}
+
 // show the ports that have been claimed
 void UAVPortList::debug_ports() {
     for(auto e : list) {
-        auto key = e.first;
         auto info = e.second;
         Serial.print(info->port_id); Serial.print(":");
-        Serial.print(FPSTR(info->dtf_name)); Serial.println();
+        Serial.print(FPSTR(info->dtf_name));
+        // compressed size as a percentage of the original, and the time spent, each way
+        if(info->compress) {
+            Serial.print(" compressed tx:");
+            Serial.print(info->stats_compress_in>0 ? (uint32_t)(info->stats_compress_out*100/info->stats_compress_in) : 0);
+            Serial.print("% "); Serial.print(info->stats_compress_us); Serial.print("us rx:");
+            Serial.print(info->stats_expand_out>0 ? (uint32_t)(info->stats_expand_in*100/info->stats_expand_out) : 0);
+            Serial.print("% "); Serial.print(info->stats_expand_us); Serial.print("us");
+        }
+        Serial.println();
     }
 }
 
 
 //
-UAVNode::UAVNode() {
+UAVNode::UAVNode(int max_subscriptions) : _session_tid(UV_NODE_MAX_SESSIONS), _subscribe_portdata(max_subscriptions), _requests_timeout(0), transfers(UV_TRANSFER_POOL_SIZE, UV_TRANSFER_BUFFER_SIZE) {
     // simplest anonymous node
     local_node_id = 0xFFFF;
 }
 
 UAVNode::~UAVNode() {
+    // send anything left in an unfinished batch
+    batch_flush();
     // stop all remaining transports
     for(auto t : _transports) t->stop(*this);
+    delete[] _compress_buffer;
+    delete[] _compress_table;
+    delete[] _expand_buffer;
 }
 
 #ifdef ESP8266
@@ -87,11 +162,14 @@ void UAVNode::subscribe(UAVPortID subject_id, PGM_P dtf_name, UAVPortListener fn
         // notify transports of port creation
         for(auto t : _transports) t->port(*this, subject_id, info);
     }
-    // add the function to the listeners list
-    if(fn!=nullptr) {
-        auto key = std::make_tuple(subject_id, info->dt_hash);
-        _subscribe_portdata[key] = fn;
+    // add the port and function to the listeners list
+    UAVNodeSubscription* subscription = _subscribe_portdata.insert(subject_id, info->dt_hash);
+    if(subscription==nullptr) {
+        Serial.print("subscribe table full ");
+        return;
     }
+    subscription->info = info;
+    if(fn!=nullptr) subscription->fn = std::move(fn);
 }
 
 // declare that we will be emitting subjects of this datatype
@@ -119,10 +197,22 @@ void UAVNode::define_service(uint16_t service_id, PGM_P dtf_name, UAVPortFunctio
             // let everyone know
             for(auto t : _transports) t->port(*this, port_id, port_info);
         }
-        port_info->on_request.push_front(fn);
+        port_info->on_request.push_front(std::move(fn));
     }
 }
 
+// compression is a property of the port, so it has to be claimed like any other
+void UAVNode::compress_subject(uint16_t subject_id, PGM_P dtf_name, int threshold) {
+    UAVNodePortInfo* port_info = ports.port_claim(subject_id, dtf_name);
+    if(port_info==nullptr) return;
+    port_info->compress = true;
+    port_info->compress_threshold = threshold;
+}
+
+void UAVNode::compress_service(uint16_t service_id, PGM_P dtf_name, int threshold) {
+    compress_subject(service_id | 0x8000, dtf_name, threshold);
+}
+
 /*
  * DataType Hash functions, aka Compact data type identifier
  * 
@@ -193,7 +283,7 @@ UAVDatatypeHash UAVNode::datatypehash(const char *name) {
         uint32_t dtname_hash = crc32c((uint8_t *)part[2], size[2]) & 0xFFF;
         // extract the major version
         char major[size[3]+1];
-        for(j=0; j<size[0]; j++) major[j] = part[3][j];
+        for(j=0; j<size[3]; j++) major[j] = part[3][j];
         major[j++] = 0;
         uint8_t version = strtol(&major[0],NULL,10);
         // append them all together and return
@@ -207,7 +297,7 @@ UAVDatatypeHash UAVNode::datatypehash(const char *name) {
 UAVDatatypeHash UAVNode::datatypehash_P(PGM_P name, size_t size) {
     // fill temporary RAM string from flash
     char dt_name[size+1];
-    strncpy_P(dt_name, (PGM_P)name, size);
+    memcpy_P(dt_name, (PGM_P)name, size);
     dt_name[size] = 0;
     // compute the hash from the in-memory name
     return datatypehash(dt_name);
@@ -238,6 +328,8 @@ UAVDatatypeHash UAVNode::datatypehash(const char *root_ns, const char *subroot_n
 
 void UAVNode::add(UAVTransport *transport) {
     _transports.push_back(transport);
+    // transports with a period are only polled on their schedule
+    if(transport->period>0) _schedule.add(transport, _now);
     transport->start(*this);
 }
 
@@ -245,6 +337,7 @@ void UAVNode::remove(UAVTransport *transport) {
     auto it = std::find(_transports.begin(), _transports.end(), transport);
     if(it==_transports.end()) return;
     _transports.erase(it);
+    _schedule.remove(transport);
     transport->stop(*this);
 }
 
@@ -255,6 +348,9 @@ void UAVNode::port_update(UAVPortID port_id, UAVNodePortInfo* port_info) {
 
 void UAVNode::add(UAVTask *task) {
     _tasks.push_back(task);
+    // tasks without their own period run at the node default
+    if(task->period==0) task->period = task_schedule;
+    _schedule.add(task, _now);
     task->start(*this);
 }
 
@@ -262,34 +358,37 @@ void UAVNode::remove(UAVTask *task) {
     auto it = std::find(_tasks.begin(), _tasks.end(), task);
     if(it==_tasks.end()) return;
     _tasks.erase(it);
+    _schedule.remove(task);
     task->stop(*this);
 }
 
-UAVTransferID UAVNode::next_subject_tid(UAVPortID port) {
-    uint64_t counter;
-    auto search = _subject_tid.find(port);
-    if (search != _subject_tid.end()) {
-        counter = search->second + 1;
-        search->second = counter;
-    } else {
-        _subject_tid[port] = 0;
-        counter = 0;
-    }
-    return counter;
+UAVTransferID UAVNode::next_session_tid(UAVPortID port, UAVNodeID node_id) {
+    return _session_tid.next(port, node_id);
 }
 
-UAVTransferID UAVNode::next_session_tid(UAVPortID port, UAVNodeID node_id) {
-    uint64_t counter;
-    auto key = std::make_tuple(port, node_id);
-    auto search = _session_tid.find(key);
-    if (search != _session_tid.end()) {
-        counter = search->second + 1;
-        search->second = counter;
-    } else {
-        _session_tid[key] = 0;
-        counter = 0;
+void UAVNode::debug_fairness() {
+    // how much of the loop each transport and task is taking
+    int index = 0;
+    for(auto transport : _transports) {
+        Serial.print("transport #"); Serial.print(index++);
+        debug_busy(transport);
+        Serial.print(" throttled:"); Serial.print(transport->throttled);
+        Serial.println();
+    }
+    index = 0;
+    for(auto task : _tasks) {
+        Serial.print("task #"); Serial.print(index++);
+        debug_busy(task);
+        Serial.print(" late_max:"); Serial.print(task->late_max);
+        Serial.println();
     }
-    return counter;
+}
+
+void UAVNode::debug_busy(UAVScheduled* item) {
+    Serial.print(" polls:"); Serial.print(item->polls);
+    Serial.print(" busy_us:"); Serial.print((uint32_t)item->busy_total);
+    Serial.print(" avg:"); Serial.print(item->polls>0 ? (uint32_t)(item->busy_total / item->polls) : 0);
+    Serial.print(" max:"); Serial.print(item->busy_max);
 }
 
 void UAVNode::debug_transfer(UAVTransfer *transfer) {
@@ -307,7 +406,7 @@ void UAVNode::debug_transfer(UAVTransfer *transfer) {
     Serial.print((uint32_t)(tid>>32),16); Serial.print((uint32_t)(tid),16);
     Serial.print(" "); 
     // port info
-    UAVPortInfo * port = ports.list[transfer->port_id];
+    UAVPortInfo * port = ports.find(transfer->port_id, transfer->datatype);
     if(port==nullptr) {
         Serial.print((uint32_t)(transfer->datatype>>32),16); Serial.print((uint32_t)(transfer->datatype),16);
     } else {
@@ -323,127 +422,245 @@ void UAVNode::debug_transfer(UAVTransfer *transfer) {
         Serial.print(" ");
         Serial.print( data[i] ,16);
     }
-    Serial.print((transfer->payload_size>n)? ".." : " ");
+    Serial.print(((int)transfer->payload_size>n)? ".." : " ");
     Serial.print("]("); Serial.print(transfer->payload_size);
     Serial.println(")}");
 }
 
 void UAVNode::transfer_receive(UAVTransfer *transfer) {
     // debug_transfer(transfer);
+    if(on_receive) on_receive(transfer);
     // wrap an input stream around the transfer buffer
     UAVInStream in(transfer->payload, transfer->payload_size);
     // was this a subject broadcast?
     if(transfer->transfer_kind == UAVTransfer::KindMessage) {
         // check the port/datatype combined index
-        auto key = std::make_tuple(transfer->port_id, transfer->datatype);
-        auto fn = _subscribe_portdata[key];
-        if(fn!=nullptr) fn(transfer->remote_node_id, in);
+        UAVNodeSubscription* subscription = _subscribe_portdata.find(transfer->port_id, transfer->datatype);
+        if(subscription!=nullptr) {
+            if(subscription->info->compress) {
+                if(!expand_payload(transfer, subscription->info)) return;
+                in = UAVInStream(transfer->payload, transfer->payload_size);
+            }
+            subscription->info->stats_recieved++;
+            if(subscription->fn!=nullptr) subscription->fn(transfer->remote_node_id, in);
+        }
         // all done
         return;
     }
     // was it sent specifically to us?
     if(transfer->local_node_id==local_node_id) {
         if(transfer->transfer_kind == UAVTransfer::KindRequest) {
-            // do we have port functions waiting for this?
-            UAVNodePortInfo * port = ports.list[transfer->port_id | 0x8000];
+            // do we have port functions waiting for this? services answer on the port alone, whatever datatype the client named.
+            UAVNodePortInfo * port = ports.find(transfer->port_id | 0x8000, transfer->datatype);
+            if(port==nullptr) port = ports.find(transfer->port_id | 0x8000);
             if(port!=nullptr) {
+                if(port->compress) {
+                    if(!expand_payload(transfer, port)) return;
+                    in = UAVInStream(transfer->payload, transfer->payload_size);
+                }
+                port->stats_recieved++;
                 // create a reply handler for use by the functions.
                 bool reply_called = false;
-                UAVPortReply reply = [transfer,this,&reply_called](UAVOutStream& out)->void {
+                UAVPortReply reply = [transfer,port,this,&reply_called](UAVOutStream& out)->void {
                     reply_called = true;
                     respond(
                         transfer->remote_node_id, transfer->port_id, 
                         transfer->transfer_id, transfer->datatype, 
                         transfer->priority, 
-                        out.output_buffer, out.output_index
+                        out.output_buffer, out.output_index,
+                        port
                     );
                 };
                 // give any port request handlers the chance to reply. first one wins.
-                for(auto fn : port->on_request) {
+                for(auto& fn : port->on_request) {
                     fn(*this, in, reply);
                     if(reply_called) break;
                 }
             }
         }
         if(transfer->transfer_kind == UAVTransfer::KindResponse) {
+            // responses on compressed services need expanding before anyone reads them
+            UAVNodePortInfo * port = ports.find(transfer->port_id, transfer->datatype);
+            if( (port!=nullptr) && port->compress ) {
+                if(!expand_payload(transfer, port)) return;
+                in = UAVInStream(transfer->payload, transfer->payload_size);
+            }
             // look up the request index
-            auto it = _requests_inflight.find( std::make_tuple(transfer->port_id, transfer->transfer_id) );
+            auto it = _requests_inflight.find( std::make_tuple(transfer->port_id, transfer->remote_node_id, transfer->transfer_id) );
             if(it==_requests_inflight.end()) {
                 // either the request was already fulfilled and this is a duplicate response, (perhaps via redundant transports)
                 // the request never existed, or we've rebooted in the time it took to return.
                 // more or less expected behavior now, though we could log 'duplicates' if we cared.
             } else {
                 // remember the callback function
-                auto fn = it->second;
-                // erase it from the index in case things go wrong later.
+                auto fn = std::move(it->second.callback);
+                // cancel the timeout and erase it from the index in case things go wrong later.
+                _requests_timeout.cancel(&it->second.timer);
                 _requests_inflight.erase(it);
                 // make the call, we are done
-                return fn(in);
+                return fn(&in);
             } 
         }
     }
 }
 
-void UAVNode::process_timeouts(uint32_t t1_ms, uint32_t t2_ms) {
-    // start an iterator on the requests
-    auto it = _requests_timeout.lower_bound(t1_ms);
-    auto it_end = _requests_timeout.end();
-    while( it != it_end ) {
-        if(it->first<=t2_ms) {
-            // a request timed out. is it still inflight?
-            auto key = it->second;
-            auto e = _requests_inflight.find(key);
-            if(e!=_requests_inflight.end()) {
-                // it's still there. call back the request function FOR NOW with no data. this may split into an error path
-                e->second(*((UAVInStream *)nullptr));
-                // we have dealt with the request
-                _requests_inflight.erase(e);
-            }
-            // we have finished this, there may be more
-            it = _requests_timeout.erase(it);
-        } else {
-            // too far future now. all done
-            it = it_end;
+bool UAVNode::expand_payload(UAVTransfer* transfer, UAVNodePortInfo* info) {
+    uint8_t* data = transfer->payload;
+    int size = transfer->payload_size;
+    if(size>=1 && data[0]==UV_COMPRESS_NONE) {
+        // sent as it was, just skip the method byte
+        transfer->payload = &data[1];
+        transfer->payload_size = size-1;
+        info->stats_expand_in += size;
+        info->stats_expand_out += size-1;
+        return true;
+    }
+    // never expand past the limit, whatever the header claims
+    int expanded = (size>=UV_COMPRESS_HEADER_SIZE) ? (data[1] | (data[2]<<8)) : 0;
+    if( (size<UV_COMPRESS_HEADER_SIZE) || (data[0]!=UV_COMPRESS_LZ) || (expanded>UV_COMPRESS_MAX_SIZE) ) {
+        info->stats_errored++;
+        return false;
+    }
+    if(_expand_buffer==nullptr) _expand_buffer = new uint8_t[UV_COMPRESS_MAX_SIZE];
+    uint32_t start = micros();
+    int n = UAVCompressor::expand(&data[UV_COMPRESS_HEADER_SIZE], size-UV_COMPRESS_HEADER_SIZE, _expand_buffer, expanded);
+    info->stats_expand_us += micros() - start;
+    if(n!=expanded) {
+        info->stats_errored++;
+        return false;
+    }
+    info->stats_expand_in += size;
+    info->stats_expand_out += n;
+    transfer->payload = _expand_buffer;
+    transfer->payload_size = n;
+    return true;
+}
+
+void UAVNode::compress_payload(UAVTransfer* transfer, UAVNodePortInfo* info) {
+    int size = transfer->payload_size;
+    uint8_t header[UV_COMPRESS_HEADER_SIZE] = { UV_COMPRESS_NONE, (uint8_t)size, (uint8_t)(size>>8) };
+    int packed = 0;
+    if( (size>=info->compress_threshold) && (size<=UV_COMPRESS_MAX_SIZE) ) {
+        if(_compress_buffer==nullptr) {
+            _compress_buffer = new uint8_t[UV_COMPRESS_MAX_SIZE];
+            _compress_table = new uint16_t[UV_COMPRESS_HASH_SIZE];
         }
+        uint32_t start = micros();
+        // it has to save more than the header costs
+        packed = UAVCompressor::compress(transfer->payload, size, _compress_buffer, size - UV_COMPRESS_HEADER_SIZE, _compress_table);
+        info->stats_compress_us += micros() - start;
+    }
+    if(packed>0) {
+        header[0] = UV_COMPRESS_LZ;
+        transfer->set_payload(header, UV_COMPRESS_HEADER_SIZE, _compress_buffer, packed);
+    } else {
+        transfer->set_payload(header, 1, transfer->payload, size);
+    }
+    info->stats_compress_in += size;
+    info->stats_compress_out += transfer->payload_size;
+}
+
+void UAVNode::transfer_error(UAVPortID port_id, UAVDatatypeHash datatype) {
+    // errors are off the hot path, a lookup is fine here
+    UAVNodePortInfo* info = ports.find(port_id, datatype);
+    if(info!=nullptr) info->stats_errored++;
+}
+
+void UAVNode::process_timeouts(uint32_t t_ms) {
+    // collect every request timer that has run out
+    UAVTimer* timer;
+    while( (timer = _requests_timeout.expire(t_ms)) != nullptr ) {
+        // the timer is embedded in the inflight request
+        UAVNodeRequest* request = (UAVNodeRequest*)timer->context;
+        auto e = _requests_inflight.find(request->key);
+        if(e==_requests_inflight.end()) continue;
+        // take the callback and forget the request before calling, in case it makes new requests
+        auto fn = std::move(e->second.callback);
+        _requests_inflight.erase(e);
+        // call back the request function with no data
+        if(fn!=nullptr) fn(nullptr);
     }
 }
 
+void UAVNode::request_complete(UAVTransfer* transfer, void* context) {
+    // anything written out waits for its response or timeout
+    if(transfer->sent_count>0) return;
+    // every transport dropped it, so there's nothing to wait for
+    UAVNode* node = (UAVNode*)context;
+    auto e = node->_requests_inflight.find( std::make_tuple(transfer->port_id, transfer->remote_node_id, transfer->transfer_id) );
+    if(e==node->_requests_inflight.end()) return;
+    auto fn = std::move(e->second.callback);
+    node->_requests_timeout.cancel(&e->second.timer);
+    node->_requests_inflight.erase(e);
+    if(fn!=nullptr) fn(nullptr);
+}
+
 void UAVNode::loop(const unsigned long t, const int dt) {
-    // give time to each transport
-    for(auto transport : _transports) transport->loop(*this,t,dt);
+    // the first loop says what clock we're on. anything set up before it moves over, keeping its delay.
+    if(!_clock_started) {
+        _requests_timeout.rebase(t);
+        _schedule.rebase(_now, t);
+        _clock_started = true;
+    }
+    _now = t;
+    // poll the transports that don't keep a schedule
+    for(auto transport : _transports) {
+        if(transport->period==0) {
+            uint32_t start = micros();
+            transport->loop(*this,t,dt);
+            transport->busy(micros() - start);
+        }
+    }
     // if the millisecond timer has updated...
     if(dt>0) {
-        // unfulfilled request timeouts. get the range to remove:
-        uint32_t t1_ms = t - dt;
-        uint32_t t2_ms = t;
-        // if we cycled around
-        if(t1_ms > t2_ms) {
-            // then do it in two spans
-            process_timeouts(t1_ms, 0xFFFF);
-            process_timeouts(0, t2_ms);
-        } else {
-            // only takes one span
-            process_timeouts(t1_ms, t2_ms);
-        }
-        // run tasks less often
-        _task_timer += dt;
-        if(_task_timer >= task_schedule) {
-            for(UAVTask * task : _tasks) {
-                task->loop(*this,t,_task_timer);
-            }
-            _task_timer = 0;
+        // unfulfilled request timeouts
+        process_timeouts(t);
+        // wake every task and transport whose deadline has passed, earliest first
+        UAVScheduled* item;
+        while( (item = _schedule.due(t)) != nullptr ) {
+            uint32_t start = micros();
+            item->wake(*this, t, t - item->last);
+            item->busy(micros() - start);
+            _schedule.reschedule(item, t);
         }
     }
 }
 
-void UAVNode::publish(UAVPortID subject_id, UAVDatatypeHash datatype, UAVPriority priority, UAVOutStream& out, std::function<void()> callback) {
-    return publish(subject_id, datatype, priority, out.output_buffer, out.output_index, callback);
+int32_t UAVNode::next_deadline(const unsigned long t) {
+    int32_t next = _schedule.next(t);
+    // request timeouts are only checked as the loop runs, so keep waking at the task rate while any are pending
+    if( (_requests_timeout.count()>0) && ( (next<0) || (next>task_schedule) ) ) next = task_schedule;
+    return next;
+}
+
+UAVSendResult UAVNode::publish(UAVPortID subject_id, UAVDatatypeHash datatype, UAVPriority priority, UAVOutStream& out, UAVTransferHook callback, void* context) {
+    return publish(subject_id, datatype, priority, out.output_buffer, out.output_index, callback, context);
+}
+
+UAVSendResult UAVNode::publish(UAVPortID subject_id, UAVDatatypeHash datatype, UAVPriority priority, uint8_t* payload, int size, UAVTransferHook callback, void* context) {
+    // take a transfer from the pool - implicit ref() increment
+    auto transfer = transfers.acquire();
+    // raw temporary payload
+    transfer->payload = payload;
+    transfer->payload_size = size;
+    return publish_transfer(transfer, subject_id, datatype, priority, callback, context);
+}
+
+UAVTransferStream UAVNode::reserve(int size) {
+    // take a transfer from the pool and make room for the payload inside it
+    auto transfer = transfers.acquire();
+    transfer->reserve(size);
+    return UAVTransferStream(transfer, size);
+}
+
+UAVSendResult UAVNode::publish(UAVPortID subject_id, UAVDatatypeHash datatype, UAVPriority priority, UAVTransferStream& out, UAVTransferHook callback, void* context) {
+    // the payload is already in place, take over the stream's reference
+    return publish_transfer(out.commit(), subject_id, datatype, priority, callback, context);
 }
 
-void UAVNode::publish(UAVPortID subject_id, UAVDatatypeHash datatype, UAVPriority priority, uint8_t* payload, int size, std::function<void()> callback) {
-    // create a serial transfer header - implicit ref() increment
-    auto transfer = new UAVTransfer();
+UAVSendResult UAVNode::publish_transfer(UAVTransfer* transfer, UAVPortID subject_id, UAVDatatypeHash datatype, UAVPriority priority, UAVTransferHook callback, void* context) {
     transfer->on_complete = callback;
+    transfer->on_complete_context = context;
     // transfer header
     transfer->timestamp_usec = 0;
     transfer->priority = priority;
@@ -452,25 +669,74 @@ void UAVNode::publish(UAVPortID subject_id, UAVDatatypeHash datatype, UAVPriorit
     transfer->datatype = datatype;
     transfer->local_node_id = local_node_id;
     transfer->remote_node_id = 0xFFFF; // anonymous id
-    transfer->transfer_id = next_subject_tid(subject_id);
-    // raw temporary payload
-    transfer->payload = payload;
-    transfer->payload_size = size;
-    // send it via each transport
-    for(auto t : _transports) t->send(transfer);
+    // subjects we have defined keep their counter and statistics in the port info
+    UAVNodePortInfo* info = ports.find(subject_id, datatype);
+    if(info!=nullptr) {
+        transfer->transfer_id = info->next_transfer_id++;
+        transfer->port_info = info;
+        info->stats_emitted++;
+        if(info->compress) compress_payload(transfer, info);
+    } else {
+        // undeclared subjects share the session table, as if sent to the broadcast node
+        transfer->transfer_id = _session_tid.next(subject_id, 0xFFFF);
+    }
+    // inside a batch? hold on to it, and a copy of any borrowed payload, until the batch is sent
+    if(_batch_depth>0) {
+        transfer->keep_payload();
+        if(_batch_count==UV_NODE_BATCH_SIZE) batch_flush();
+        _batch[_batch_count++] = transfer;
+        return UAVSendResult();
+    }
+    return send(transfer);
+}
+
+UAVSendResult UAVNode::send(UAVTransfer* transfer) {
+    // send it via each transport, noting what each one did with it
+    UAVSendResult result;
+    int index = 0;
+    for(auto t : _transports) result.add(index++, t->send(transfer));
     // release our usage, which might complete the transfer
     transfer->unref();
+    return result;
+}
+
+bool UAVNode::writable(UAVPriority priority) {
+    // ask them all, so every full one knows to call on_writable later
+    bool ok = true;
+    for(auto t : _transports) {
+        if(!t->writable(priority)) ok = false;
+    }
+    return ok;
+}
+
+void UAVNode::publish_begin() {
+    // batches can nest, only the outermost end sends
+    _batch_depth++;
 }
 
-void UAVNode::request(UAVNodeID node_id, UAVPortID service_id, UAVDatatypeHash datatype, UAVPriority priority, UAVOutStream& out, UAVPortRequest callback) {
-    return request(node_id, service_id, datatype, priority, out.output_buffer, out.output_index, callback);
+void UAVNode::publish_end() {
+    if(_batch_depth==0) return;
+    _batch_depth--;
+    if(_batch_depth==0) batch_flush();
 }
 
-void UAVNode::request(UAVNodeID node_id, UAVPortID service_id, UAVDatatypeHash datatype, UAVPriority priority, uint8_t* payload, int size, UAVPortRequest callback) {
+void UAVNode::batch_flush() {
+    if(_batch_count==0) return;
+    // each transport gets the whole batch at once
+    for(auto t : _transports) t->send_batch(_batch, _batch_count);
+    // release our usage, which might complete the transfers
+    for(int i=0; i<_batch_count; i++) _batch[i]->unref();
+    _batch_count = 0;
+}
+
+UAVSendResult UAVNode::request(UAVNodeID node_id, UAVPortID service_id, UAVDatatypeHash datatype, UAVPriority priority, UAVOutStream& out, UAVPortRequest callback, uint32_t timeout_ms) {
+    return request(node_id, service_id, datatype, priority, out.output_buffer, out.output_index, std::move(callback), timeout_ms);
+}
+
+UAVSendResult UAVNode::request(UAVNodeID node_id, UAVPortID service_id, UAVDatatypeHash datatype, UAVPriority priority, uint8_t* payload, int size, UAVPortRequest callback, uint32_t timeout_ms) {
     UAVPortID port_id = service_id | 0x8000;
-    // create a serial transfer
-    auto transfer = new UAVTransfer();
-    transfer->on_complete = nullptr;
+    // take a transfer from the pool - implicit ref() increment
+    auto transfer = transfers.acquire();
     // transfer header
     transfer->timestamp_usec = 0;
     transfer->priority = priority;
@@ -483,23 +749,31 @@ void UAVNode::request(UAVNodeID node_id, UAVPortID service_id, UAVDatatypeHash d
     // payload
     transfer->payload_size = size;
     transfer->payload = payload;
-    // put the callback into the requests index
-    auto key = std::make_tuple(port_id, transfer->transfer_id);
-    _requests_inflight[key] = callback;
-    // put an entry into the timeout list
-    uint32_t timeout_delay = 2000;
-    uint32_t timeout_ms = millis() + timeout_delay;
-    _requests_timeout.insert(std::make_pair(timeout_ms, key));
-    // send it via each transport
-    for(auto t : _transports) t->send(transfer);  
-    // release our usage, which might complete the transfer
-    transfer->unref();
+    // compressed services are squeezed here, like subjects
+    UAVNodePortInfo* info = ports.find(port_id, datatype);
+    if( (info!=nullptr) && info->compress ) compress_payload(transfer, info);
+    // put the callback into the requests index. map entries never move, so the timer can live inside it.
+    auto key = std::make_tuple(port_id, node_id, transfer->transfer_id);
+    size_t inflight = _requests_inflight.size();
+    UAVNodeRequest& entry = _requests_inflight[key];
+    if(_requests_inflight.size()!=inflight) transfers.heap_requests++;
+    entry.key = key;
+    entry.callback = std::move(callback);
+    entry.timer.context = &entry;
+    // schedule the timeout, replacing any stale one for the same key
+    _requests_timeout.schedule(&entry.timer, _now + timeout_ms);
+    // fail it as soon as it's clear no transport sent it
+    transfer->on_complete = request_complete;
+    transfer->on_complete_context = this;
+    return send(transfer);
 }
 
-void UAVNode::respond(UAVNodeID node_id, UAVPortID service_id, UAVTransferID transfer_id, UAVDatatypeHash datatype, UAVPriority priority, uint8_t* payload, size_t size) {
-    // create a serial transfer
-    auto transfer = new UAVTransfer();
-    transfer->on_complete = nullptr;
+UAVSendResult UAVNode::respond(UAVNodeID node_id, UAVPortID service_id, UAVTransferID transfer_id, UAVDatatypeHash datatype, UAVPriority priority, uint8_t* payload, size_t size, UAVNodePortInfo* port_info) {
+    // take a transfer from the pool - implicit ref() increment
+    auto transfer = transfers.acquire();
+    // charge the service port, if we know it
+    transfer->port_info = port_info;
+    if(port_info!=nullptr) port_info->stats_emitted++;
     // transfer header
     transfer->timestamp_usec = 0;
     transfer->priority = priority;
@@ -512,9 +786,7 @@ void UAVNode::respond(UAVNodeID node_id, UAVPortID service_id, UAVTransferID tra
     // payload
     transfer->payload_size = size;
     transfer->payload = payload;
-    // send it via each transport
-    for(auto t : _transports) t->send(transfer);  
-    // release our usage, which might complete the transfer
-    transfer->unref();
+    if( (port_info!=nullptr) && port_info->compress ) compress_payload(transfer, port_info);
+    return send(transfer);
 }
 
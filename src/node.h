@@ -3,6 +3,11 @@
 
 #include "common.h"
 #include "transport.h"
+#include "portmap.h"
+#include "timerwheel.h"
+#include "callable.h"
+#include "coroutine.h"
+#include "compress.h"
 #include <stdlib.h>
 #include <vector>
 #include <map>
@@ -14,19 +19,46 @@
   #include <WiFi.h>
 #endif
 
-class UAVTask {
+// default capacity of the subject subscription table
+#ifndef UV_NODE_MAX_SUBSCRIPTIONS
+#define UV_NODE_MAX_SUBSCRIPTIONS 32
+#endif
+// default time to wait for a service response
+#ifndef UV_NODE_REQUEST_TIMEOUT
+#define UV_NODE_REQUEST_TIMEOUT 2000
+#endif
+// capacity of the port index, and of the service session transfer counters
+#ifndef UV_NODE_MAX_PORTS
+#define UV_NODE_MAX_PORTS 32
+#endif
+#ifndef UV_NODE_MAX_SESSIONS
+#define UV_NODE_MAX_SESSIONS 32
+#endif
+#define UV_NODE_SESSION_WAYS 4
+// number of publishes collected by a batch before it is handed to the transports
+#ifndef UV_NODE_BATCH_SIZE
+#define UV_NODE_BATCH_SIZE 16
+#endif
+
+// application task. loop() is called every period milliseconds, or every node task_schedule when the period is 0.
+class UAVTask : public UAVScheduled {
     public:
-        virtual void start(UAVNode& node);
-        virtual void stop(UAVNode& node);
-        virtual void loop(UAVNode& node, const unsigned long t, const int dt);
+        virtual void start(UAVNode& node) { }
+        virtual void stop(UAVNode& node) { }
+        virtual void loop(UAVNode& node, const unsigned long t, const int dt) { }
+        void wake(UAVNode& node, const unsigned long t, const int dt) override { loop(node, t, dt); }
 };
 
-// 
-using UAVPortListener = std::function<void(UAVNodeID node_id, UAVInStream& in)>;
-using UAVPortRequest = std::function<void(UAVInStream& in)>;
-using UAVPortReply = std::function<void(UAVOutStream& out)>;
+// port callbacks. inline callables, so they never allocate. replies are passed by reference since they can't be copied.
+using UAVPortListener = UAVCallable<void(UAVNodeID node_id, UAVInStream& in)>;
+using UAVPortRequest = UAVCallable<void(UAVInStream* in)>;   // in is nullptr when the request timed out
+using UAVPortReply = UAVCallable<void(UAVOutStream& out)>;
 //
-using UAVPortFunction = std::function<void(UAVNode& node, UAVInStream& in, UAVPortReply reply)>;
+using UAVPortFunction = UAVCallable<void(UAVNode& node, UAVInStream& in, UAVPortReply& reply)>;
+// a transport that was full has room again at this priority
+using UAVWritableHook = UAVCallable<void(UAVTransport* transport, UAVPriority priority)>;
+// sees every transfer the transports hand up, before it is dispatched. for monitors and capture decoders.
+using UAVTransferMonitor = UAVCallable<void(UAVTransfer* transfer)>;
 
 // generic properties for a port
 class UAVPortInfo {
@@ -45,19 +77,75 @@ class UAVPortInfo {
 // extra properties when being instanced in node
 class UAVNodePortInfo : public UAVPortInfo {
     public: 
+        // transfer statistics. errored counts both received transfers that failed crc and outgoing transfers that were dropped.
         uint64_t stats_emitted = 0;
         uint64_t stats_recieved = 0;
         uint64_t stats_errored = 0;
-        // std::forward_list< std::function<void(UAVNode * node, uint8_t* payload, int payload_size, UAVPortReply reply)> > on_request;
+        // transfer id counter for subjects we publish
+        UAVTransferID next_transfer_id = 0;
+        // payload compression, which both ends must turn on for the port. payloads under the threshold are sent as they are.
+        bool     compress = false;
+        uint16_t compress_threshold = UV_COMPRESS_THRESHOLD;
+        // payload bytes before and after compressing outgoing transfers and expanding incoming ones, and the microseconds it took
+        uint64_t stats_compress_in = 0;
+        uint64_t stats_compress_out = 0;
+        uint32_t stats_compress_us = 0;
+        uint64_t stats_expand_in = 0;
+        uint64_t stats_expand_out = 0;
+        uint32_t stats_expand_us = 0;
         std::forward_list<UAVPortFunction> on_request;
         UAVNodePortInfo(UAVPortID port, PGM_P name) : UAVPortInfo{port,name} { }
 };
 
+// subject subscription entry, keeps the port info next to the listener so receive stats cost no extra lookup
+class UAVNodeSubscription {
+    public:
+        UAVNodePortInfo*    info = nullptr;
+        UAVPortListener     fn;
+};
+
+// an outstanding service request, waiting for the response or the timeout
+class UAVNodeRequest {
+    public:
+        std::tuple<UAVPortID,UAVNodeID,UAVTransferID> key;
+        UAVPortRequest  callback;
+        UAVTimer        timer;
+};
+
+/*
+    Bounded table of transfer id counters for service sessions, keyed by (port, remote node).
+    Set-associative, so a lookup only ever scans a few entries. When a set is full the least recently used entry is evicted.
+    New counters start from a clock that advances on every allocation, so a session that was evicted and comes back
+    still never reuses an earlier transfer id.
+*/
+class UAVSessionCounters {
+    protected:
+        typedef struct {
+            UAVPortID       port_id;
+            UAVNodeID       node_id;
+            uint32_t        used;       // clock value at last use, zero when empty
+            UAVTransferID   next;
+        } Entry;
+        Entry*          _entries;
+        int             _set_mask;
+        UAVTransferID   _clock = 0;
+    public:
+        uint32_t evictions = 0;
+        UAVSessionCounters(int capacity);
+        ~UAVSessionCounters();
+        UAVTransferID next(UAVPortID port_id, UAVNodeID node_id);
+};
+
 class UAVPortList {
     private:
     public:
         std::map<UAVPortID, UAVNodePortInfo*> list;
+        // constant-time index by port and datatype, for the send path. ports claimed once it is full are only in the list.
+        UAVPortMap<UAVNodePortInfo*> index;
+        UAVPortList() : index(UV_NODE_MAX_PORTS) { }
         UAVNodePortInfo* port_claim(UAVPortID port_id, PGM_P dtf_name);
+        UAVNodePortInfo* find(UAVPortID port_id, UAVDatatypeHash datatype);
+        UAVNodePortInfo* find(UAVPortID port_id);
         // destructor
         ~UAVPortList();
         // instance list on node
@@ -69,30 +157,50 @@ class UAVNode {
     protected:
         // transport interfaces
         std::vector<UAVTransport *> _transports;
-        std::map< UAVPortID, UAVTransferID> _subject_tid;
-        std::map< std::tuple<UAVPortID,UAVNodeID>, UAVTransferID> _session_tid;
-        UAVTransferID next_subject_tid(UAVPortID port);
+        UAVSessionCounters _session_tid;
         UAVTransferID next_session_tid(UAVPortID port, UAVNodeID node_id);
-        // task list
-        int _task_timer = 0;
+        // task list, and the wake schedule for tasks and periodic transports
         std::vector<UAVTask *> _tasks;
+        UAVScheduler _schedule;
         // service maps
-        std::map< std::tuple<UAVPortID,UAVDatatypeHash>, UAVPortListener> _subscribe_portdata;
-        std::map< std::tuple<UAVPortID,UAVTransferID>, UAVPortRequest> _requests_inflight;
-        std::multimap< uint32_t, std::tuple<UAVPortID,UAVTransferID>> _requests_timeout;
-        // timeout management
-        void process_timeouts(uint32_t t1_ms, uint32_t t2_ms);
+        UAVPortMap<UAVNodeSubscription> _subscribe_portdata;
+        std::map< std::tuple<UAVPortID,UAVNodeID,UAVTransferID>, UAVNodeRequest> _requests_inflight;
+        UAVTimerWheel _requests_timeout;
+        // the time loop() was last called with. timeouts and deadlines are set on this clock, whatever it is.
+        uint32_t _now = 0;
+        bool _clock_started = false;
+        // batched publishing
+        UAVTransfer* _batch[UV_NODE_BATCH_SIZE];
+        int _batch_count = 0;
+        int _batch_depth = 0;
+        void batch_flush();
+        UAVSendResult publish_transfer(UAVTransfer* transfer, UAVPortID subject_id, UAVDatatypeHash datatype, UAVPriority priority, UAVTransferHook callback, void* context);
+        UAVSendResult send(UAVTransfer* transfer);
+        // payload compression scratch space, allocated the first time a compressed port needs it
+        uint8_t* _compress_buffer = nullptr;
+        uint16_t* _compress_table = nullptr;
+        uint8_t* _expand_buffer = nullptr;
+        void compress_payload(UAVTransfer* transfer, UAVNodePortInfo* info);
+        bool expand_payload(UAVTransfer* transfer, UAVNodePortInfo* info);
+        // timeout management, and failing requests that no transport sent
+        void process_timeouts(uint32_t t_ms);
+        static void request_complete(UAVTransfer* transfer, void* context);
         void debug_transfer(UAVTransfer *transfer);
+        void debug_busy(UAVScheduled* item);
         // port management
         void port_update(UAVPortID port_id, UAVNodePortInfo* port_info);
     public:
         // public variables
         UAVNodeID local_node_id = 0;    // local node id
         UAVPortList ports;              // local node ports
-        int task_schedule = 10;         // task schedule time
+        UAVTransferPool transfers;      // outgoing transfer pool
+        UAVWritableHook on_writable;    // backpressure relief, see writable()
+        UAVTransferMonitor on_receive;  // every received transfer, see transfer_receive()
+        int task_schedule = 10;         // default task period
         std::function<uint64_t()> get_time_us; // microsecond time function
         // con/destructor
-        UAVNode();
+        UAVNode(int max_subscriptions);
+        UAVNode() : UAVNode(UV_NODE_MAX_SUBSCRIPTIONS) { }
         virtual ~UAVNode();
         // setup IP address properties from a wifi connection
 #ifdef ESP8266
@@ -103,25 +211,50 @@ class UAVNode {
 #endif
         // event loop
         void loop(const unsigned long t, const int dt);
+        // milliseconds until the next task or transport deadline, so the caller can sleep. -1 when nothing is scheduled.
+        int32_t next_deadline(const unsigned long t);
+        // print the time each transport and task has taken in the loop, and how often transports hit their i/o budget
+        void debug_fairness();
         // transport management
         void add(UAVTransport *transport);
         void remove(UAVTransport *transport);
         void transfer_receive(UAVTransfer *transfer);
+        // a transport received a transfer for this port that failed its checks
+        void transfer_error(UAVPortID port_id, UAVDatatypeHash datatype);
         // task management
         void add(UAVTask *task);
         void remove(UAVTask *task);
         // subject and service definition
         void define_subject(uint16_t subject_id, PGM_P dtf_name);
         void define_service(uint16_t service_id, PGM_P dtf_name, UAVPortFunction fn);
+        // turn on payload compression for a subject or service. the nodes at the other end have to do the same.
+        void compress_subject(uint16_t subject_id, PGM_P dtf_name, int threshold = UV_COMPRESS_THRESHOLD);
+        void compress_service(uint16_t service_id, PGM_P dtf_name, int threshold = UV_COMPRESS_THRESHOLD);
         // subject subscription
         void subscribe(UAVPortID subject_id, PGM_P dtf_name, UAVPortListener fn);
-        // subject publishing
-        void publish(UAVPortID subject_id, UAVDatatypeHash datatype, UAVPriority priority, uint8_t* payload, int size, std::function<void()> callback);
-        void publish(UAVPortID subject_id, UAVDatatypeHash datatype, UAVPriority priority, UAVOutStream& out, std::function<void()> callback);
+        // subject publishing. the result says what each transport did with it. the callback gets the transfer when every transport is done with it.
+        // the payload is only lent, so it is copied into the transfer if a transport has to queue it.
+        UAVSendResult publish(UAVPortID subject_id, UAVDatatypeHash datatype, UAVPriority priority, uint8_t* payload, int size, UAVTransferHook callback = nullptr, void* context = nullptr);
+        UAVSendResult publish(UAVPortID subject_id, UAVDatatypeHash datatype, UAVPriority priority, UAVOutStream& out, UAVTransferHook callback = nullptr, void* context = nullptr);
+        // zero-copy publishing. serialize into a reserved transfer, then publish the stream to send it without copying.
+        UAVTransferStream reserve(int size);
+        UAVSendResult publish(UAVPortID subject_id, UAVDatatypeHash datatype, UAVPriority priority, UAVTransferStream& out, UAVTransferHook callback = nullptr, void* context = nullptr);
+        // publish batches. publishes between begin and end are handed to each transport in one send_batch() call, and return an empty result.
+        void publish_begin();
+        void publish_end();
         // service request & response
-        void request(UAVNodeID node_id, UAVPortID service_id, UAVDatatypeHash datatype, UAVPriority priority, uint8_t* payload, int size, UAVPortRequest callback);
-        void request(UAVNodeID node_id, UAVPortID service_id, UAVDatatypeHash datatype, UAVPriority priority, UAVOutStream& out, UAVPortRequest callback);
-        void respond(UAVNodeID node_id, UAVPortID service_id, UAVTransferID transfer_id, UAVDatatypeHash datatype, UAVPriority priority, uint8_t* payload, size_t size);
+        UAVSendResult request(UAVNodeID node_id, UAVPortID service_id, UAVDatatypeHash datatype, UAVPriority priority, uint8_t* payload, int size, UAVPortRequest callback, uint32_t timeout_ms = UV_NODE_REQUEST_TIMEOUT);
+        UAVSendResult request(UAVNodeID node_id, UAVPortID service_id, UAVDatatypeHash datatype, UAVPriority priority, UAVOutStream& out, UAVPortRequest callback, uint32_t timeout_ms = UV_NODE_REQUEST_TIMEOUT);
+        UAVSendResult respond(UAVNodeID node_id, UAVPortID service_id, UAVTransferID transfer_id, UAVDatatypeHash datatype, UAVPriority priority, uint8_t* payload, size_t size, UAVNodePortInfo* port_info = nullptr);
+        // can every transport take a transfer at this priority right now? when one can't, on_writable is called once it can.
+        bool writable(UAVPriority priority);
+#ifdef UV_COROUTINES
+        // awaitable service request, resumes the coroutine with the parsed reply or a timeout
+        template <typename T>
+        UAVRequestAwaitable<T> request_async(UAVNodeID node_id, UAVPortID service_id, UAVDatatypeHash datatype, UAVPriority priority, uint8_t* payload, int size, uint32_t timeout_ms = UV_NODE_REQUEST_TIMEOUT);
+        template <typename T>
+        UAVRequestAwaitable<T> request_async(UAVNodeID node_id, UAVPortID service_id, UAVDatatypeHash datatype, UAVPriority priority, UAVOutStream& out, uint32_t timeout_ms = UV_NODE_REQUEST_TIMEOUT);
+#endif
         // datatype hash functions - used to turn arbitrary-length full datatype names into fixed-length integers with group-sortable semantics
         static UAVDatatypeHash datatypehash_P(PGM_P name);
         static UAVDatatypeHash datatypehash_P(PGM_P name, size_t size);
@@ -130,4 +263,72 @@ class UAVNode {
 };
 
 
+// scoped publish batch, everything published while it is alive goes out together
+class UAVPublishBatch {
+    protected:
+        UAVNode& _node;
+    public:
+        UAVPublishBatch(UAVNode& node) : _node(node) { _node.publish_begin(); }
+        ~UAVPublishBatch() { _node.publish_end(); }
+};
+
+#ifdef UV_COROUTINES
+/*
+    Awaitable for UAVNode::request_async. The request goes out when the coroutine suspends, and the
+    node's request callback parses the reply into the result and resumes the coroutine directly.
+    A request no transport could send fails inside request(), before the coroutine has suspended,
+    so then await_suspend returns false and the coroutine carries on without being resumed.
+*/
+template <typename T>
+class UAVRequestAwaitable {
+    protected:
+        UAVNode&        _node;
+        UAVNodeID       _node_id;
+        UAVPortID       _service_id;
+        UAVDatatypeHash _datatype;
+        UAVPriority     _priority;
+        uint8_t*        _payload;
+        int             _size;
+        uint32_t        _timeout_ms;
+        UAVResult<T>    _result;
+        std::coroutine_handle<> _handle;
+        bool            _done = false;
+        bool            _suspended = false;
+    public:
+        UAVRequestAwaitable(UAVNode& node, UAVNodeID node_id, UAVPortID service_id, UAVDatatypeHash datatype, UAVPriority priority, uint8_t* payload, int size, uint32_t timeout_ms) 
+            : _node(node), _node_id(node_id), _service_id(service_id), _datatype(datatype), _priority(priority), _payload(payload), _size(size), _timeout_ms(timeout_ms) { }
+        bool await_ready() { return false; }
+        bool await_suspend(std::coroutine_handle<> handle) {
+            _handle = handle;
+            _node.request(_node_id, _service_id, _datatype, _priority, _payload, _size, 
+                [this](UAVInStream* in) {
+                    if(in!=nullptr) {
+                        *in >> _result.value;
+                        _result.ok = true;
+                    }
+                    _done = true;
+                    // only resume a coroutine that has actually suspended
+                    if(_suspended) _handle.resume();
+                }, 
+                _timeout_ms
+            );
+            // already answered or failed, so don't suspend at all
+            if(_done) return false;
+            _suspended = true;
+            return true;
+        }
+        UAVResult<T> await_resume() { return std::move(_result); }
+};
+
+template <typename T>
+UAVRequestAwaitable<T> UAVNode::request_async(UAVNodeID node_id, UAVPortID service_id, UAVDatatypeHash datatype, UAVPriority priority, uint8_t* payload, int size, uint32_t timeout_ms) {
+    return UAVRequestAwaitable<T>(*this, node_id, service_id, datatype, priority, payload, size, timeout_ms);
+}
+
+template <typename T>
+UAVRequestAwaitable<T> UAVNode::request_async(UAVNodeID node_id, UAVPortID service_id, UAVDatatypeHash datatype, UAVPriority priority, UAVOutStream& out, uint32_t timeout_ms) {
+    return UAVRequestAwaitable<T>(*this, node_id, service_id, datatype, priority, out.output_buffer, out.output_index, timeout_ms);
+}
+#endif
+
 #endif
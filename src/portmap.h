@@ -0,0 +1,102 @@
+#ifndef LIBUAVESP_PORTMAP_H_INCLUDED
+#define LIBUAVESP_PORTMAP_H_INCLUDED
+
+#include "common.h"
+#include "transport.h"
+#include <utility>
+
+/*
+    Fixed-capacity open-addressed hash table keyed by (port id, datatype hash).
+    Used for the per-message dispatch lookups in the node, where a tree walk on every received frame is too slow.
+    Keys are kept in their own packed array so a probe sequence only touches key memory, values are looked up
+    by index once a key matches. Lookups never insert, and values are handed out by pointer so they are never copied.
+*/
+template <typename V>
+class UAVPortMap {
+    protected:
+        typedef struct {
+            UAVDatatypeHash datatype;
+            UAVPortID       port_id;
+            bool            used;
+        } Key;
+        Key*    _keys;
+        V*      _values;
+        int     _mask;
+        int     _count = 0;
+        int     _limit;
+        // mix the port and datatype into a slot index
+        int slot(UAVPortID port_id, UAVDatatypeHash datatype) const {
+            uint32_t h = (uint32_t)datatype ^ (uint32_t)(datatype>>32) ^ ((uint32_t)port_id * 0x9E3779B1);
+            h ^= h >> 15;
+            h *= 0x2C1B3C6D;
+            h ^= h >> 12;
+            return h & _mask;
+        }
+    public:
+        UAVPortMap(int capacity) {
+            // table size is the next power of two that keeps the load factor under 3/4
+            int size = 8;
+            while(size*3 < capacity*4) size <<= 1;
+            _mask = size-1;
+            _limit = capacity;
+            _keys = new Key[size];
+            _values = new V[size];
+            for(int i=0; i<size; i++) _keys[i].used = false;
+        }
+        ~UAVPortMap() {
+            delete[] _keys;
+            delete[] _values;
+        }
+        // owns its arrays, so it can't be copied
+        UAVPortMap(const UAVPortMap&) = delete;
+        UAVPortMap& operator=(const UAVPortMap&) = delete;
+        // find an existing entry. never inserts.
+        V* find(UAVPortID port_id, UAVDatatypeHash datatype) const {
+            int i = slot(port_id, datatype);
+            while(_keys[i].used) {
+                if( (_keys[i].port_id==port_id) && (_keys[i].datatype==datatype) ) return &_values[i];
+                i = (i+1) & _mask;
+            }
+            return nullptr;
+        }
+        // find or create an entry. returns nullptr if the table is at capacity.
+        V* insert(UAVPortID port_id, UAVDatatypeHash datatype) {
+            int i = slot(port_id, datatype);
+            while(_keys[i].used) {
+                if( (_keys[i].port_id==port_id) && (_keys[i].datatype==datatype) ) return &_values[i];
+                i = (i+1) & _mask;
+            }
+            if(_count>=_limit) return nullptr;
+            _keys[i].port_id = port_id;
+            _keys[i].datatype = datatype;
+            _keys[i].used = true;
+            _count++;
+            return &_values[i];
+        }
+        // remove an entry, shifting later members of the probe chain back so lookups never need tombstones
+        bool remove(UAVPortID port_id, UAVDatatypeHash datatype) {
+            V* value = find(port_id, datatype);
+            if(value==nullptr) return false;
+            int i = value - _values;
+            int j = i;
+            while(true) {
+                j = (j+1) & _mask;
+                if(!_keys[j].used) break;
+                // can the entry at j legally move back into the hole at i?
+                int k = slot(_keys[j].port_id, _keys[j].datatype);
+                if( ((j>i) && ((k<=i) || (k>j))) || ((j<i) && (k<=i) && (k>j)) ) {
+                    _keys[i] = _keys[j];
+                    _values[i] = std::move(_values[j]);
+                    i = j;
+                }
+            }
+            _keys[i].used = false;
+            _values[i] = V();
+            _count--;
+            return true;
+        }
+        int count() const { return _count; }
+        int capacity() const { return _limit; }
+};
+
+#endif
@@ -29,8 +29,7 @@ uint8_t first_uint8_onebit(uint8_t v) {
     \param f The float16 value in a 16 bit integer wrapper format.
 */
 float fp16_to_float(uint16_t f) {
-    float r = 0;
-    uint32_t* bv = (uint32_t*)&r;
+    uint32_t b = 0;
     // fp16 properties
     uint32_t fp16_sign = (f >> 15) & 1;
     uint32_t fp16_exp = (f >> 10) & 0x1F;
@@ -40,12 +39,12 @@ float fp16_to_float(uint16_t f) {
     // is it one of the special conditions?
     if(fp16_exp==0x1F) {
         // sign bit plus infinity exponent plus NaN junk
-        *bv = fp32_sign | 0x7F80000 | (fp16_mantissa<<13);
+        b = fp32_sign | 0x7F80000 | (fp16_mantissa<<13);
     } else if(fp16_exp==0) {
         // subnormal (small) number   = (-1)s ∙ 2-14 ∙ 0.mmmmmmmmmm
         if(fp16_mantissa==0) {
             // signed zero. easy.
-            *bv = fp32_sign;
+            b = fp32_sign;
         } else {
             // where is the first binary 1 digit in the 10-bit mantissa?
             int fp16_digit;
@@ -61,13 +60,16 @@ float fp16_to_float(uint16_t f) {
             // what exponent will the padded value have
             uint32_t fp32_exp = 127-15-fp16_pad;
             // just zero-pad the lsb of the number
-            *bv = fp32_sign | (fp32_exp << 23) | ( (fp16_mantissa<<(13+fp16_pad)) & 0x007FFFFF);
+            b = fp32_sign | (fp32_exp << 23) | ( (fp16_mantissa<<(13+fp16_pad)) & 0x007FFFFF);
         }
     } else {
         // normalized number  = (-1)s ∙ 2(eeeee-15) ∙ 1.mmmmmmmmmm
         uint32_t fp32_exp = fp16_exp+(127-15);
-        *bv = fp32_sign | (fp32_exp << 23) | (fp16_mantissa<<13);
+        b = fp32_sign | (fp32_exp << 23) | (fp16_mantissa<<13);
     }
+    // copy the bits over, rather than type-punning through a pointer
+    float r;
+    memcpy(&r, &b, sizeof(r));
     return r;
 }
 
@@ -75,7 +77,8 @@ float fp16_to_float(uint16_t f) {
     \param f The float value
 */
 uint16_t float_to_fp16(float f) {
-    uint32_t bv = *(uint32_t*)&f;
+    uint32_t bv;
+    memcpy(&bv, &f, sizeof(bv));
     // fp16 properties
     uint32_t fp32_sign = (bv >> 31) & 1;
     uint32_t fp32_exp = (bv >> 22) & 0xFF;
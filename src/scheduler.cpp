@@ -0,0 +1,93 @@
+#include "scheduler.h"
+
+void UAVScheduler::place(int index, UAVScheduled* item) {
+    _heap[index] = item;
+    item->heap_index = index;
+}
+
+void UAVScheduler::sift_up(int index) {
+    UAVScheduled* item = _heap[index];
+    while(index>0) {
+        int parent = (index-1) / 2;
+        if(!before(item, _heap[parent])) break;
+        place(index, _heap[parent]);
+        index = parent;
+    }
+    place(index, item);
+}
+
+void UAVScheduler::sift_down(int index) {
+    UAVScheduled* item = _heap[index];
+    int count = _heap.size();
+    while(true) {
+        int child = index*2 + 1;
+        if(child>=count) break;
+        // pick the earlier of the two children
+        if( (child+1<count) && before(_heap[child+1], _heap[child]) ) child++;
+        if(!before(_heap[child], item)) break;
+        place(index, _heap[child]);
+        index = child;
+    }
+    place(index, item);
+}
+
+void UAVScheduler::add(UAVScheduled* item, uint32_t now) {
+    if(item->heap_index>=0) remove(item);
+    item->last = now;
+    item->deadline = now + item->period;
+    _heap.push_back(item);
+    sift_up(_heap.size()-1);
+}
+
+void UAVScheduler::remove(UAVScheduled* item) {
+    int index = item->heap_index;
+    item->heap_index = -1;
+    if(index<0) return;
+    // move the last item into the hole and restore the heap either way
+    UAVScheduled* last = _heap.back();
+    _heap.pop_back();
+    if(last==item) return;
+    place(index, last);
+    sift_up(index);
+    sift_down(last->heap_index);
+}
+
+UAVScheduled* UAVScheduler::due(uint32_t now) {
+    if(_heap.empty()) return nullptr;
+    UAVScheduled* item = _heap[0];
+    if((int32_t)(now - item->deadline) < 0) return nullptr;
+    remove(item);
+    item->heap_index = -2;
+    return item;
+}
+
+void UAVScheduler::reschedule(UAVScheduled* item, uint32_t now) {
+    // removed while it was waking?
+    if(item->heap_index!=-2) return;
+    // how late were we?
+    uint32_t late = now - item->deadline;
+    item->runs++;
+    item->late_total += late;
+    if(late>item->late_max) item->late_max = late;
+    // next deadline keeps the original phase, dropping whole periods we missed
+    uint32_t period = item->period>0 ? item->period : 1;
+    item->deadline += period * (late/period + 1);
+    item->last = now;
+    _heap.push_back(item);
+    sift_up(_heap.size()-1);
+}
+
+void UAVScheduler::rebase(uint32_t from, uint32_t to) {
+    // the same shift for everything leaves the heap order alone
+    uint32_t shift = to - from;
+    for(auto item : _heap) {
+        item->deadline += shift;
+        item->last += shift;
+    }
+}
+
+int32_t UAVScheduler::next(uint32_t now) const {
+    if(_heap.empty()) return -1;
+    int32_t delta = (int32_t)(_heap[0]->deadline - now);
+    return delta>0 ? delta : 0;
+}
@@ -0,0 +1,56 @@
+#ifndef LIBUAVESP_SCHEDULER_H_INCLUDED
+#define LIBUAVESP_SCHEDULER_H_INCLUDED
+
+#include "common.h"
+#include <vector>
+
+class UAVNode;
+
+// something the node wakes up on a period, eg. tasks and polled transports
+class UAVScheduled {
+    public:
+        uint32_t    period = 0;         // milliseconds between wakes
+        uint32_t    deadline = 0;       // next wake time, managed by the scheduler
+        uint32_t    last = 0;           // time of the previous wake
+        int         heap_index = -1;    // position in the scheduler heap, -1 when not scheduled, -2 while waking
+        // lateness statistics, in milliseconds past the deadline
+        uint32_t    runs = 0;
+        uint32_t    late_max = 0;
+        uint64_t    late_total = 0;
+        // time spent in each wake or poll, in microseconds, so hogs show up
+        uint32_t    busy_max = 0;
+        uint64_t    busy_total = 0;
+        uint32_t    polls = 0;
+        void busy(uint32_t us) { polls++; busy_total += us; if(us>busy_max) busy_max = us; }
+        virtual void wake(UAVNode& node, const unsigned long t, const int dt) = 0;
+        virtual ~UAVScheduled() { }
+};
+
+/*
+    Min-heap of scheduled items ordered by deadline.
+    Deadlines are 32-bit milliseconds compared as signed differences, so millis() wraparound is handled.
+*/
+class UAVScheduler {
+    protected:
+        std::vector<UAVScheduled*> _heap;
+        static bool before(UAVScheduled* a, UAVScheduled* b) { return (int32_t)(a->deadline - b->deadline) < 0; }
+        void place(int index, UAVScheduled* item);
+        void sift_up(int index);
+        void sift_down(int index);
+    public:
+        // schedule an item, first waking one period from now
+        void add(UAVScheduled* item, uint32_t now);
+        void remove(UAVScheduled* item);
+        // pop the earliest item if its deadline has passed, or nullptr
+        UAVScheduled* due(uint32_t now);
+        // record the run statistics and put the item back at its next deadline, skipping any missed periods.
+        // items removed while they were waking stay removed.
+        void reschedule(UAVScheduled* item, uint32_t now);
+        // move every item from one clock to another, keeping how far off its deadline is
+        void rebase(uint32_t from, uint32_t to);
+        // milliseconds until the next deadline, 0 when overdue, -1 when nothing is scheduled
+        int32_t next(uint32_t now) const;
+        int count() const { return _heap.size(); }
+};
+
+#endif
@@ -0,0 +1,116 @@
+#include "timerwheel.h"
+
+UAVTimerWheel::UAVTimerWheel(uint32_t now) {
+    _next = now;
+    for(int l=0; l<UV_TIMER_WHEEL_LEVELS; l++) {
+        for(int i=0; i<UV_TIMER_WHEEL_SIZE; i++) _slots[l][i] = nullptr;
+    }
+}
+
+void UAVTimerWheel::rebase(uint32_t now) {
+    uint32_t offset = now - _next;
+    // take every timer off the wheel, the expired ones included
+    UAVTimer* all = _expired;
+    _expired = nullptr;
+    for(int l=0; l<UV_TIMER_WHEEL_LEVELS; l++) {
+        for(int i=0; i<UV_TIMER_WHEEL_SIZE; i++) {
+            UAVTimer* timer = _slots[l][i];
+            _slots[l][i] = nullptr;
+            while(timer!=nullptr) {
+                UAVTimer* next = timer->next;
+                timer->next = all;
+                all = timer;
+                timer = next;
+            }
+        }
+    }
+    // and put them back, as far from the new time as they were from the old
+    _next = now;
+    while(all!=nullptr) {
+        UAVTimer* next = all->next;
+        all->expires += offset;
+        place(all);
+        all = next;
+    }
+}
+
+void UAVTimerWheel::place(UAVTimer* timer) {
+    uint32_t expires = timer->expires;
+    int32_t delta = (int32_t)(expires - _next);
+    UAVTimer** slot;
+    if(delta < 0) {
+        // already overdue, goes off on the next tick
+        slot = &_slots[0][_next & UV_TIMER_WHEEL_MASK];
+    } else if((uint32_t)delta < UV_TIMER_WHEEL_RANGE) {
+        // find the finest level that can hold the delay
+        int level = 0;
+        while((uint32_t)delta >= ((uint32_t)1 << (UV_TIMER_WHEEL_BITS*(level+1)))) level++;
+        slot = &_slots[level][(expires >> (UV_TIMER_WHEEL_BITS*level)) & UV_TIMER_WHEEL_MASK];
+    } else {
+        // too far in the future. park it at the edge of the wheel, it gets re-placed when that slot cascades
+        int level = UV_TIMER_WHEEL_LEVELS-1;
+        uint32_t edge = _next + UV_TIMER_WHEEL_RANGE - 1;
+        slot = &_slots[level][(edge >> (UV_TIMER_WHEEL_BITS*level)) & UV_TIMER_WHEEL_MASK];
+    }
+    // link at the head of the slot list
+    timer->next = *slot;
+    if(timer->next!=nullptr) timer->next->prev = &timer->next;
+    timer->prev = slot;
+    *slot = timer;
+}
+
+void UAVTimerWheel::schedule(UAVTimer* timer, uint32_t expires) {
+    if(timer->active()) cancel(timer);
+    timer->expires = expires;
+    place(timer);
+    _count++;
+}
+
+void UAVTimerWheel::cancel(UAVTimer* timer) {
+    if(!timer->active()) return;
+    // unlink from whichever list we are in
+    *timer->prev = timer->next;
+    if(timer->next!=nullptr) timer->next->prev = timer->prev;
+    timer->next = nullptr;
+    timer->prev = nullptr;
+    _count--;
+}
+
+void UAVTimerWheel::cascade(int level, int index) {
+    // take the whole slot list and re-place each timer on a finer level
+    UAVTimer* timer = _slots[level][index];
+    _slots[level][index] = nullptr;
+    while(timer!=nullptr) {
+        UAVTimer* next = timer->next;
+        place(timer);
+        timer = next;
+    }
+}
+
+UAVTimer* UAVTimerWheel::expire(uint32_t now) {
+    while( (_expired==nullptr) && ((int32_t)(now - _next) >= 0) ) {
+        // nothing scheduled? then there's no need to walk the ticks
+        if(_count==0) {
+            _next = now + 1;
+            return nullptr;
+        }
+        int index = _next & UV_TIMER_WHEEL_MASK;
+        // when a level wraps, pull the next slot down from the level above
+        int level = 1;
+        int i = index;
+        while( (i==0) && (level<UV_TIMER_WHEEL_LEVELS) ) {
+            i = (_next >> (UV_TIMER_WHEEL_BITS*level)) & UV_TIMER_WHEEL_MASK;
+            cascade(level, i);
+            level++;
+        }
+        // move the slot list over to the expired list, where it can still be cancelled
+        _expired = _slots[0][index];
+        _slots[0][index] = nullptr;
+        if(_expired!=nullptr) _expired->prev = &_expired;
+        _next++;
+    }
+    // hand out the expired timers one at a time
+    UAVTimer* timer = _expired;
+    if(timer!=nullptr) cancel(timer);
+    return timer;
+}
@@ -0,0 +1,47 @@
+#ifndef LIBUAVESP_TIMERWHEEL_H_INCLUDED
+#define LIBUAVESP_TIMERWHEEL_H_INCLUDED
+
+#include "common.h"
+
+// four levels of 64 slots covers 2^24 milliseconds (about 4.6 hours) before timers are re-cascaded
+#define UV_TIMER_WHEEL_BITS     6
+#define UV_TIMER_WHEEL_SIZE     (1<<UV_TIMER_WHEEL_BITS)
+#define UV_TIMER_WHEEL_MASK     (UV_TIMER_WHEEL_SIZE-1)
+#define UV_TIMER_WHEEL_LEVELS   4
+#define UV_TIMER_WHEEL_RANGE    ((uint32_t)1<<(UV_TIMER_WHEEL_BITS*UV_TIMER_WHEEL_LEVELS))
+
+// intrusive timer entry, embedded in whatever object needs the timeout
+class UAVTimer {
+    public:
+        uint32_t    expires = 0;        // absolute millisecond time, wraps with millis()
+        void*       context = nullptr;  // owner data, for whoever collects the expired timer
+        UAVTimer*   next = nullptr;
+        UAVTimer**  prev = nullptr;     // address of whichever pointer links to us
+        bool active() const { return prev!=nullptr; }
+};
+
+/*
+    Hierarchical timing wheel with O(1) schedule and cancel.
+    Time is kept as 32-bit milliseconds and only ever compared as signed differences,
+    so the 49 day millis() wraparound is handled without any special cases.
+*/
+class UAVTimerWheel {
+    protected:
+        UAVTimer*   _slots[UV_TIMER_WHEEL_LEVELS][UV_TIMER_WHEEL_SIZE];
+        UAVTimer*   _expired = nullptr; // timers whose tick has been processed but not yet collected
+        uint32_t    _next;      // next millisecond tick to be processed
+        int         _count = 0;
+        void place(UAVTimer* timer);
+        void cascade(int level, int index);
+    public:
+        UAVTimerWheel(uint32_t now);
+        // move the wheel's clock to 'now', and every timer by the same amount, for when the owner learns what its clock really reads
+        void rebase(uint32_t now);
+        void schedule(UAVTimer* timer, uint32_t expires);
+        void cancel(UAVTimer* timer);
+        // collect the next timer that expired at or before 'now', or nullptr when there are none left
+        UAVTimer* expire(uint32_t now);
+        int count() const { return _count; }
+};
+
+#endif
@@ -1,4 +1,5 @@
 #include "transport.h"
+#include "node.h"
 //#include "transports/canard.h"
 //#include "transports/serial.h"
 //#include "transports/udp.h"
@@ -17,22 +18,156 @@ void UAVTransfer::unref() {
     if(ref_count==0) return;
     ref_count--;
     if(ref_count==0) {
-        if(on_complete!=nullptr) on_complete();
-        delete this;
+        if(on_complete!=nullptr) on_complete(this, on_complete_context);
+        if(pool!=nullptr) {
+            pool->release(this);
+        } else {
+            delete this;
+        }
     }
 }
+// reserve payload space, inline if it fits
+void UAVTransfer::reserve(int size) {
+    uint8_t* block = buffer;
+    if(size > buffer_size) {
+        storage = new uint8_t[size];
+        block = storage;
+        if(pool!=nullptr) pool->heap_blocks++;
+    }
+    payload = block;
+    payload_size = 0;
+    payload_owned = true;
+}
+// take a copy of a payload we were only lent
+void UAVTransfer::keep_payload() {
+    if(payload_owned) return;
+    uint8_t* block = buffer;
+    if((int)payload_size > buffer_size) {
+        storage = new uint8_t[payload_size];
+        block = storage;
+        if(pool!=nullptr) pool->heap_blocks++;
+    }
+    if(payload_size>0) memcpy(block, payload, payload_size);
+    if(pool!=nullptr) pool->copied += payload_size;
+    payload = block;
+    payload_owned = true;
+}
+// replace the payload, moving the old one along if the new one is built from it
+void UAVTransfer::set_payload(const uint8_t* header, int header_size, const uint8_t* data, int size) {
+    int total = header_size + size;
+    uint8_t* old = storage;
+    uint8_t* block = buffer;
+    if(total > buffer_size) {
+        storage = new uint8_t[total];
+        block = storage;
+        if(pool!=nullptr) pool->heap_blocks++;
+    } else {
+        storage = nullptr;
+    }
+    if(size>0) memmove(&block[header_size], data, size);
+    if(header_size>0) memcpy(block, header, header_size);
+    if(old!=storage) delete[] old;
+    payload = block;
+    payload_size = total;
+    payload_owned = true;
+}
+// frame header space, after an inline payload or at the start of an unused inline buffer
+uint8_t* UAVTransfer::frame_alloc(int size) {
+    int used = 0;
+    if( payload_owned && (storage==nullptr) ) used = payload_size;
+    if(used + size <= buffer_size) return &buffer[used];
+    frame_owned = true;
+    if(pool!=nullptr) pool->heap_blocks++;
+    return new uint8_t[size];
+}
+// dropped transfers count as errors on their port
+void UAVTransfer::dropped() {
+    drop_count++;
+    if(port_info!=nullptr) port_info->stats_errored++;
+}
+// release the encoded frame, unless it lives in our inline buffer, and any payload storage
+void UAVTransfer::free_frame() {
+    if(frame_owned) delete[] frame_data;
+    frame_data = nullptr;
+    frame_size = 0;
+    frame_owned = false;
+    frame_stride = 0;
+    delete[] storage;
+    storage = nullptr;
+    payload_owned = false;
+}
 // destructor
 UAVTransfer::~UAVTransfer() {
     // assume we are the owner of frame_data
-    if(frame_data != nullptr) {
-        delete frame_data;
+    free_frame();
+}
+
+// UAVTransferPool
+UAVTransferPool::UAVTransferPool(int count, int buffer_size) {
+    size = count;
+    _transfers = new UAVTransfer[count];
+    _buffers = new uint8_t[count * buffer_size];
+    _free = new UAVTransfer*[count];
+    // everything starts on the free list, with its own slice of the buffer block
+    for(int i=0; i<count; i++) {
+        UAVTransfer* transfer = &_transfers[i];
+        transfer->pool = this;
+        transfer->buffer = &_buffers[i * buffer_size];
+        transfer->buffer_size = buffer_size;
+        transfer->ref_count = 0;
+        _free[i] = transfer;
+    }
+    _free_count = count;
+}
+
+UAVTransferPool::~UAVTransferPool() {
+    delete[] _transfers;
+    delete[] _buffers;
+    delete[] _free;
+}
+
+UAVTransfer* UAVTransferPool::acquire() {
+    UAVTransfer* transfer;
+    if(_free_count>0) {
+        transfer = _free[--_free_count];
+        in_use++;
+        if(in_use>high_water) high_water = in_use;
+    } else {
+        // pool exhausted, fall back to the heap
+        exhausted++;
+        transfer = new UAVTransfer();
     }
+    // fresh reference and no leftover hooks
+    transfer->ref_count = 1;
+    transfer->on_complete = nullptr;
+    transfer->on_complete_context = nullptr;
+    transfer->port_info = nullptr;
+    transfer->sent_count = 0;
+    transfer->drop_count = 0;
+    return transfer;
+}
+
+void UAVTransferPool::release(UAVTransfer* transfer) {
+    transfer->free_frame();
+    _free[_free_count++] = transfer;
+    in_use--;
+}
+
+// UAVTransferStream
+UAVTransfer* UAVTransferStream::commit() {
+    UAVTransfer* t = transfer;
+    transfer = nullptr;
+    t->payload_size = output_index;
+    return t;
 }
 
 // UAVSerialPort
 // stream methods
 void UAVSerialPort::read(uint8_t *buffer, int count) { }
 void UAVSerialPort::write(uint8_t *buffer, int count) { }
+void UAVSerialPort::flush() { }
+int UAVSerialPort::readCount() { return 0; }
+int UAVSerialPort::writeCount() { return 0; }
 
 void UAVSerialPort::print(char * string) {
     int remain = strlen(string);
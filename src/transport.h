@@ -2,6 +2,7 @@
 #define UV_TRANSPORT_H_INCLUDED
 
 #include "common.h"
+#include "scheduler.h"
 #include <vector>
 #include <map>
 #include <functional>
@@ -17,19 +18,66 @@ using UAVDatatypeHash   = uint64_t;
 
 // generic transfer structure
 class UAVTransfer;
+class UAVTransferPool;
 class UAVNodePortInfo;
 
+// transfer completion hook. a plain function pointer and context, so setting one never allocates
+using UAVTransferHook = void (*) (UAVTransfer* transfer, void* context);
+
+// number of transfers a node keeps ready for sending, and the inline frame buffer each one carries
+#ifndef UV_TRANSFER_POOL_SIZE
+#define UV_TRANSFER_POOL_SIZE   16
+#endif
+#ifndef UV_TRANSFER_BUFFER_SIZE
+#define UV_TRANSFER_BUFFER_SIZE 96
+#endif
+
+// what became of a transfer handed to a transport
+typedef uint8_t UAVSendStatus;
+#define UV_SEND_QUEUED      0   // waiting in the transport queue
+#define UV_SEND_SENT        1   // written out straight away
+#define UV_SEND_DROPPED     2   // lost, eg. out of buffers or no route
+#define UV_SEND_REJECTED    3   // the queue was full. try again when the transport is writable
+
+// per-transport outcome of a publish, request or respond. bit n stands for the node's nth transport.
+class UAVSendResult {
+    public:
+        uint32_t    queued = 0;
+        uint32_t    sent = 0;
+        uint32_t    dropped = 0;
+        uint32_t    rejected = 0;
+        void add(int index, UAVSendStatus status) {
+            uint32_t bit = (uint32_t)1 << (index & 31);
+            switch(status) {
+                case UV_SEND_QUEUED:    queued |= bit; break;
+                case UV_SEND_SENT:      sent |= bit; break;
+                case UV_SEND_DROPPED:   dropped |= bit; break;
+                case UV_SEND_REJECTED:  rejected |= bit; break;
+            }
+        }
+        // did any transport take it?
+        explicit operator bool() const { return (queued | sent) != 0; }
+};
+
 // forward declaration of used classes
 class UAVNode;
 
 // abstract interface for transports
-class UAVTransport {
+// transports are polled on every node loop, unless they set a period and are only woken on that schedule
+class UAVTransport : public UAVScheduled {
     public:
+        void wake(UAVNode& node, const unsigned long t, const int dt) override { loop(node, t, dt); }
         virtual bool start(UAVNode& node) { return true; }
         virtual void port(UAVNode& node, UAVPortID port_id, UAVNodePortInfo* info) { }
         virtual bool stop(UAVNode& node) { return true; }
         virtual void loop(UAVNode& node, const unsigned long t, const int dt) { }
-        virtual void send(UAVTransfer* transfer) { }
+        virtual UAVSendStatus send(UAVTransfer* transfer) { return UV_SEND_DROPPED; }
+        // send several transfers at once. transports that can coalesce frames override this.
+        virtual void send_batch(UAVTransfer** transfers, int count) { for(int i=0; i<count; i++) send(transfers[i]); }
+        // would a send at this priority be queued without dropping anything? a transport that says no calls the node's on_writable once it has room.
+        virtual bool writable(UAVPriority priority) { return true; }
+        // loops that stopped at their i/o budget with work left over
+        uint32_t throttled = 0;
 
         // little-endian integer encoding into transfer buffers - deprecated
         static void encode_uint16(uint8_t *buffer, uint16_t v);
@@ -57,15 +105,45 @@ class UAVTransfer {
         UAVTransferID       transfer_id;
         size_t              payload_size;
         uint8_t*            payload;
-        // encoded serial frame
-        int                 frame_size = 0;
+        // encoded serial frame headers and trailers, sent around the payload, and whether they were allocated on the heap
+        int                 frame_size = 0;     // size on the wire before escaping, payload included
         uint8_t*            frame_data = nullptr;
+        bool                frame_owned = false;
+        int                 frame_stride = 0;   // when split into several frames, the size of each full one
+        // inline storage for the payload and frame headers, used instead of the heap when they fit
+        int                 buffer_size = 0;
+        uint8_t*            buffer = nullptr;
+        // true once the payload lives in the transfer (see reserve() and keep_payload()), so it is freed with it
+        bool                payload_owned = false;
+        uint8_t*            storage = nullptr;  // heap block for payloads too big for the inline buffer
+        // port statistics to charge, when the transfer belongs to a known port
+        UAVNodePortInfo*    port_info = nullptr;
+        // how many transports wrote the transfer out, and how many gave up on it. on_complete can tell from these whether it went anywhere.
+        uint8_t             sent_count = 0;
+        uint8_t             drop_count = 0;
+        // owning pool, or nullptr for heap and stack transfers
+        UAVTransferPool*    pool = nullptr;
         // reference counter
         int ref_count = 1;
         void ref(); 
         void unref(); 
         // all transfers complete callback
-        std::function<void()> on_complete;
+        UAVTransferHook     on_complete = nullptr;
+        void*               on_complete_context = nullptr;
+        // set aside room for a payload of up to size bytes
+        void reserve(int size);
+        // copy a borrowed payload into the transfer, so it stays valid for as long as the transfer is referenced
+        void keep_payload();
+        // replace the payload with a copy of header followed by data, which may be the current payload
+        void set_payload(const uint8_t* header, int header_size, const uint8_t* data, int size);
+        // space for frame headers that transports send alongside the payload. uses what the payload leaves of the inline buffer.
+        uint8_t* frame_alloc(int size);
+        // release any heap frame buffer and reserved storage
+        void free_frame();
+        // count a transfer that a transport has finished writing
+        void sent() { sent_count++; }
+        // count a transfer that was dropped before it was sent
+        void dropped();
         // virtual destructor
         virtual ~UAVTransfer();
 
@@ -86,6 +164,37 @@ class UAVTransfer {
 };
 
 
+/*
+    Fixed-capacity pool of transfers for the send path.
+    Transfers are handed out with a single reference and come back here when the last reference is released,
+    so steady-state publishing never touches the heap. When the pool runs dry a heap transfer is created instead,
+    and the event is counted so the pool can be sized from field data.
+*/
+class UAVTransferPool {
+    protected:
+        UAVTransfer*    _transfers;
+        uint8_t*        _buffers;
+        UAVTransfer**   _free;
+        int             _free_count;
+    public:
+        // pool statistics
+        int             size;
+        int             in_use = 0;
+        int             high_water = 0;
+        uint32_t        exhausted = 0;
+        uint32_t        copied = 0;     // bytes of borrowed payloads copied into pooled transfers
+        // what still comes from the heap: payloads and frames too big for the inline buffer, and an index entry per request
+        uint32_t        heap_blocks = 0;
+        uint32_t        heap_requests = 0;
+        // con/destructor
+        UAVTransferPool(int count, int buffer_size);
+        ~UAVTransferPool();
+        // take a transfer with one reference, from the pool or the heap
+        UAVTransfer* acquire();
+        // return a completed transfer
+        void release(UAVTransfer* transfer);
+};
+
 // abstract interface for serial transports
 class UAVSerialTransport : public UAVTransport {
     public:
@@ -101,6 +210,7 @@ class UAVSerialPort {
         virtual void flush();
         virtual int readCount();
         virtual int writeCount();
+        virtual ~UAVSerialPort() { }
         void print(char * string);
         void println();
         void println(char * string);
@@ -181,4 +291,20 @@ class UAVOutStream {
         // friend UAVOutStream& operator<<(UAVOutStream& s, const PGM_P& v) { s.output_memcpy_P(v,strlen_P(v)); return s; }
 };
 
+/*
+    Output stream that writes straight into a reserved transfer, see UAVNode::reserve().
+    The stream holds the transfer reference until it is handed to UAVNode::publish(), which sends it without copying
+    the payload. A stream that is dropped without being published just releases its transfer.
+*/
+class UAVTransferStream : public UAVOutStream {
+    public:
+        UAVTransfer* transfer;
+        UAVTransferStream(UAVTransfer* t, int size) : UAVOutStream(t->payload, size), transfer(t) { }
+        UAVTransferStream(UAVTransferStream&& other) : UAVOutStream(other), transfer(other.transfer) { other.transfer = nullptr; }
+        UAVTransferStream(const UAVTransferStream&) = delete;
+        ~UAVTransferStream() { if(transfer!=nullptr) transfer->unref(); }
+        // give up the transfer, with the written length as its payload size
+        UAVTransfer* commit();
+};
+
 #endif
\ No newline at end of file
@@ -33,7 +33,7 @@ bool CanardTransport::stop(UAVNode& node) {
 }
 
 
-void CanardTransport::send(UAVTransfer* transfer) {
+UAVSendStatus CanardTransport::send(UAVTransfer* transfer) {
     // create a CAN transfer frame from the generic transfer
     CanardTransfer *ct = new CanardTransfer();
     ct->timestamp_usec = 0;
@@ -44,8 +44,12 @@ void CanardTransport::send(UAVTransfer* transfer) {
     ct->remote_node_id = transfer->remote_node_id;
     ct->payload_size = transfer->payload_size;
     ct->payload = transfer->payload;
-    // push that to the canard stack
-    canardTxPush(&_canard, ct);
+    // push that to the canard stack, which copies the payload into its own queue
+    if(canardTxPush(&_canard, ct) < 0) {
+        transfer->dropped();
+        return UV_SEND_DROPPED;
+    }
+    return UV_SEND_QUEUED;
 }
 
 #endif
\ No newline at end of file
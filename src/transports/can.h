@@ -27,7 +27,7 @@ class CanardTransport : public UAVTransport {
         void port(UAVNode& node, UAVPortID port_id, UAVNodePortInfo* info) override;
         bool stop(UAVNode& node) override;
         void loop(UAVNode& node, const unsigned long t, const int dt) { };
-        void send(UAVTransfer* transfer) override;
+        UAVSendStatus send(UAVTransfer* transfer) override;
 };
 #endif
 #endif
@@ -0,0 +1,159 @@
+#include "capture.h"
+
+// capture port
+
+CaptureSerialPort::CaptureSerialPort(UAVSerialPort* port, bool owner, int size) : _ring(size) {
+    _port = port;
+    _owner = owner;
+    _last = micros();
+    _ring.write((const uint8_t*)UV_CAPTURE_MAGIC, UV_CAPTURE_MAGIC_SIZE);
+}
+
+CaptureSerialPort::~CaptureSerialPort() {
+    if(_owner) delete _port;
+}
+
+void CaptureSerialPort::record(uint8_t kind, const uint8_t* data, int count) {
+    if(!enabled || (count<=0)) return;
+    uint8_t header[UV_CAPTURE_MAX_HEADER];
+    uint32_t now = micros();
+    // own up to anything missed first, so the decoder knows there's a gap
+    if(_lost>0) {
+        header[0] = UV_CAPTURE_LOST;
+        int n = 1 + SerialTransport::encode_varint(&header[1], now - _last);
+        n += SerialTransport::encode_varint(&header[n], _lost);
+        if(_ring.writeCount() < n + UV_CAPTURE_MAX_HEADER + count) {
+            _lost += count;
+            lost += count;
+            return;
+        }
+        _ring.write(header, n);
+        _last = now;
+        _lost = 0;
+    }
+    header[0] = kind;
+    int n = 1 + SerialTransport::encode_varint(&header[1], now - _last);
+    n += SerialTransport::encode_varint(&header[n], count);
+    // whole records or nothing
+    if(_ring.writeCount() < n + count) {
+        _lost += count;
+        lost += count;
+        return;
+    }
+    _ring.write(header, n);
+    _ring.write(data, count);
+    _last = now;
+}
+
+void CaptureSerialPort::read(uint8_t *buffer, int count) {
+    _port->read(buffer, count);
+    record(UV_CAPTURE_RX, buffer, count);
+}
+
+void CaptureSerialPort::write(uint8_t *buffer, int count) {
+    _port->write(buffer, count);
+    record(UV_CAPTURE_TX, buffer, count);
+}
+
+void CaptureSerialPort::flush() {
+    _port->flush();
+}
+
+int CaptureSerialPort::readCount() {
+    return _port->readCount();
+}
+
+int CaptureSerialPort::writeCount() {
+    return _port->writeCount();
+}
+
+int CaptureSerialPort::drain(UAVSerialPort* sink) {
+    uint8_t block[UV_SERIAL_IO_BUFFER_SIZE];
+    int total = 0;
+    while(true) {
+        int n = min(min(sink->writeCount(), _ring.readCount()), (int)sizeof(block));
+        if(n<=0) break;
+        _ring.read(block, n);
+        sink->write(block, n);
+        total += n;
+    }
+    return total;
+}
+
+// capture decoder
+
+CaptureDecoder::CaptureDecoder() : rx(_null), tx(_null) {
+    rx.promiscuous = true;
+    tx.promiscuous = true;
+    node.add(&rx);
+    node.add(&tx);
+}
+
+CaptureDecoder::~CaptureDecoder() {
+    // the transports are members after the node, so they go first. take them off it before they do.
+    node.remove(&rx);
+    node.remove(&tx);
+}
+
+bool CaptureDecoder::field(uint8_t c) {
+    // varints, little-endian base 128
+    _value |= (uint64_t)(c & 0x7F) << _shift;
+    _shift += 7;
+    if(c & 0x80) {
+        if(_shift>=64) valid = false;
+        return false;
+    }
+    _shift = 0;
+    return true;
+}
+
+bool CaptureDecoder::decode(const uint8_t* data, int count) {
+    int i = 0;
+    while( (i<count) && valid ) {
+        switch(_state) {
+            case 0:
+                // the magic
+                if(data[i++] != (uint8_t)UV_CAPTURE_MAGIC[_index++]) valid = false;
+                if(_index==UV_CAPTURE_MAGIC_SIZE) _state = 1;
+                break;
+            case 1:
+                _kind = data[i++];
+                if( (_kind<UV_CAPTURE_RX) || (_kind>UV_CAPTURE_LOST) ) valid = false;
+                _value = 0;
+                _state = 2;
+                break;
+            case 2:
+                if(field(data[i++])) {
+                    time_us += _value;
+                    _value = 0;
+                    _state = 3;
+                }
+                break;
+            case 3:
+                if(field(data[i++])) {
+                    _remain = _value;
+                    records++;
+                    _state = 4;
+                    if(_kind==UV_CAPTURE_LOST) {
+                        lost += _remain;
+                        _state = 1;
+                    } else if(_remain==0) {
+                        _state = 1;
+                    }
+                }
+                break;
+            case 4: {
+                // hand the bytes to the transport for that direction, as they would have arrived
+                int n = min((uint32_t)(count - i), _remain);
+                direction = _kind;
+                SerialTransport* t = (_kind==UV_CAPTURE_RX) ? &rx : &tx;
+                t->parse_buffer((uint8_t*)&data[i], n, &node);
+                i += n;
+                _remain -= n;
+                if(_remain==0) _state = 1;
+                break;
+            }
+        }
+    }
+    return valid;
+}
@@ -0,0 +1,82 @@
+#ifndef LIBUAVESP_TRANSPORT_CAPTURE_H_INCLUDED
+#define LIBUAVESP_TRANSPORT_CAPTURE_H_INCLUDED
+
+#include "../common.h"
+#include "../node.h"
+#include "../transport.h"
+#include "serial.h"
+
+/*
+    Binary capture format. The stream starts with the 8 byte magic, then a record per port read or write:
+        kind byte, varint microseconds since the previous record, varint length, then the bytes.
+    Lost records carry no bytes, their length is how many weren't captured because the buffer was full.
+*/
+#define UV_CAPTURE_MAGIC        "UVCAP01\n"
+#define UV_CAPTURE_MAGIC_SIZE   8
+#define UV_CAPTURE_RX           1
+#define UV_CAPTURE_TX           2
+#define UV_CAPTURE_LOST         3
+#define UV_CAPTURE_MAX_HEADER   11
+// capture ring size, rounded up to a power of two
+#ifndef UV_CAPTURE_BUFFER_SIZE
+#define UV_CAPTURE_BUFFER_SIZE  8192
+#endif
+
+// wraps a port and records its traffic, at the cost of a memcpy per read or write rather than formatting each byte
+class CaptureSerialPort : public UAVSerialPort {
+    protected:
+        UAVSerialPort*  _port;
+        bool            _owner;
+        SerialRing      _ring;
+        uint32_t        _last;
+        uint32_t        _lost = 0;      // bytes missed since the last lost record
+        void record(uint8_t kind, const uint8_t* data, int count);
+    public:
+        bool            enabled = true;
+        uint32_t        lost = 0;       // bytes missed in total
+        CaptureSerialPort(UAVSerialPort* port, bool owner, int size = UV_CAPTURE_BUFFER_SIZE);
+        CaptureSerialPort(UAVSerialPort* port) : CaptureSerialPort(port,true) { };
+        CaptureSerialPort(UAVSerialPort& port) : CaptureSerialPort(&port,false) { };
+        ~CaptureSerialPort();
+        void read(uint8_t *buffer, int count) override;
+        void write(uint8_t *buffer, int count) override;
+        void flush() override;
+        int readCount() override;
+        int writeCount() override;
+        // the capture stream, to be pulled out by the app or written to another port as room allows
+        int captureCount() { return _ring.readCount(); }
+        int readCapture(uint8_t *buffer, int count) { return _ring.read(buffer, count); }
+        int drain(UAVSerialPort* sink);
+};
+
+/*
+    Turns a capture stream back into frames and transfers, offline or on a host.
+    Each direction is parsed by its own promiscuous serial transport into the decoder's node, so on_receive on the
+    node sees every transfer, and time_us and direction say when and which way it went.
+*/
+class CaptureDecoder {
+    protected:
+        LoopbackSerialPort  _null;
+        int                 _state = 0;     // magic, kind, time, length, data
+        int                 _index = 0;
+        uint8_t             _kind = 0;
+        uint64_t            _value = 0;
+        int                 _shift = 0;
+        uint32_t            _remain = 0;
+        bool field(uint8_t c);
+    public:
+        UAVNode             node;
+        SerialTransport     rx;
+        SerialTransport     tx;
+        uint64_t            time_us = 0;
+        uint8_t             direction = 0;
+        uint32_t            records = 0;
+        uint32_t            lost = 0;
+        bool                valid = true;   // false once the stream stops looking like a capture
+        CaptureDecoder();
+        ~CaptureDecoder();
+        // feed the next piece of the stream, in pieces of any size
+        bool decode(const uint8_t* data, int count);
+};
+
+#endif
@@ -0,0 +1,170 @@
+#include "posix.h"
+
+#ifdef UV_POSIX_SERIAL
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <termios.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+
+PosixSerialPort::PosixSerialPort(const char* path, uint32_t baud) {
+    _owner = true;
+    _fd = ::open(path, O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if( (_fd>=0) && !configure(_fd, baud) ) {
+        ::close(_fd);
+        _fd = -1;
+    }
+}
+
+PosixSerialPort::PosixSerialPort(int fd, bool owner) {
+    _fd = fd;
+    _owner = owner;
+    if(_fd>=0) fcntl(_fd, F_SETFL, fcntl(_fd, F_GETFL) | O_NONBLOCK);
+}
+
+PosixSerialPort::~PosixSerialPort() {
+    if(_owner && (_fd>=0)) ::close(_fd);
+}
+
+bool PosixSerialPort::configure(int fd, uint32_t baud) {
+    speed_t speed;
+    switch(baud) {
+        case 9600:    speed = B9600; break;
+        case 19200:   speed = B19200; break;
+        case 38400:   speed = B38400; break;
+        case 57600:   speed = B57600; break;
+        case 115200:  speed = B115200; break;
+        case 230400:  speed = B230400; break;
+#ifdef B460800
+        case 460800:  speed = B460800; break;
+#endif
+#ifdef B921600
+        case 921600:  speed = B921600; break;
+#endif
+#ifdef B1000000
+        case 1000000: speed = B1000000; break;
+#endif
+#ifdef B2000000
+        case 2000000: speed = B2000000; break;
+#endif
+#ifdef B3000000
+        case 3000000: speed = B3000000; break;
+#endif
+#ifdef B4000000
+        case 4000000: speed = B4000000; break;
+#endif
+        default: return false;
+    }
+    struct termios tio;
+    if(tcgetattr(fd, &tio)!=0) return false;
+    // raw bytes, 8N1, no flow control, reads return whatever is there
+    cfmakeraw(&tio);
+    tio.c_cflag |= CLOCAL | CREAD;
+    tio.c_cflag &= ~(CSTOPB | CRTSCTS);
+    tio.c_cc[VMIN] = 0;
+    tio.c_cc[VTIME] = 0;
+    cfsetispeed(&tio, speed);
+    cfsetospeed(&tio, speed);
+    return tcsetattr(fd, TCSANOW, &tio)==0;
+}
+
+PosixSerialPort* PosixSerialPort::open_pty(char* name, int size) {
+    int fd = posix_openpt(O_RDWR | O_NOCTTY);
+    if(fd<0) return nullptr;
+    if( (grantpt(fd)!=0) || (unlockpt(fd)!=0) || (ptsname(fd)==nullptr) ) {
+        ::close(fd);
+        return nullptr;
+    }
+    if(name!=nullptr) {
+        strncpy(name, ptsname(fd), size);
+        name[size-1] = 0;
+    }
+    // the master is a terminal too, keep it from echoing or translating anything
+    configure(fd, 115200);
+    return new PosixSerialPort(fd, true);
+}
+
+void PosixSerialPort::read(uint8_t *buffer, int count) {
+    // the caller asked for what readCount() said was there, so it gets exactly count bytes
+    while(count>0) {
+        int n = ::read(_fd, buffer, count);
+        if(n>0) {
+            buffer += n;
+            count -= n;
+            continue;
+        }
+        if( (n<0) && (errno==EINTR) ) continue;
+        // not quite there yet, give it a moment
+        if( (n<0) && ((errno==EAGAIN) || (errno==EWOULDBLOCK)) ) {
+            pollfd p = { _fd, POLLIN, 0 };
+            int ready = poll(&p, 1, UV_POSIX_READ_WAIT);
+            if( (ready>0) || ((ready<0) && (errno==EINTR)) ) continue;
+        }
+        // closed, failed or timed out. zero the rest, so a frame it lands in fails its crc instead of decoding stale bytes.
+        errors++;
+        memset(buffer, 0, count);
+        return;
+    }
+}
+
+bool PosixSerialPort::drain() {
+    // push out what the kernel refused last time
+    while(!_pending.empty()) {
+        int n = ::write(_fd, _pending.data(), _pending.size());
+        if(n<=0) {
+            if( (n<0) && (errno!=EAGAIN) && (errno!=EWOULDBLOCK) && (errno!=EINTR) ) {
+                errors++;
+                _pending.clear();
+            }
+            return false;
+        }
+        _pending.erase(_pending.begin(), _pending.begin() + n);
+    }
+    return true;
+}
+
+void PosixSerialPort::write(uint8_t *buffer, int count) {
+    if(drain()) {
+        int n = ::write(_fd, buffer, count);
+        if(n<0) {
+            if( (errno!=EAGAIN) && (errno!=EWOULDBLOCK) && (errno!=EINTR) ) {
+                errors++;
+                return;
+            }
+            n = 0;
+        }
+        buffer += n;
+        count -= n;
+    }
+    // hold the rest, in order, up to tx_buffer bytes
+    int room = max(tx_buffer - (int)_pending.size(), 0);
+    if(count>room) {
+        overruns += count - room;
+        count = room;
+    }
+    if(count>0) _pending.insert(_pending.end(), buffer, buffer + count);
+}
+
+void PosixSerialPort::flush() {
+    drain();
+}
+
+int PosixSerialPort::readCount() {
+    int count = 0;
+    if(ioctl(_fd, FIONREAD, &count)!=0) return 0;
+    return count;
+}
+
+int PosixSerialPort::writeCount() {
+    if(!drain()) return 0;
+    int queued = 0;
+#ifdef TIOCOUTQ
+    if(ioctl(_fd, TIOCOUTQ, &queued)!=0) queued = 0;
+#endif
+    return max(tx_buffer - queued, 0);
+}
+
+#endif
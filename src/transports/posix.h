@@ -0,0 +1,57 @@
+#ifndef LIBUAVESP_TRANSPORT_POSIX_H_INCLUDED
+#define LIBUAVESP_TRANSPORT_POSIX_H_INCLUDED
+
+#include "../common.h"
+#include "../transport.h"
+
+// serial ports on linux and mac hosts, eg. gateways and ground stations running the same framing code
+#if defined(__linux__) || defined(__APPLE__)
+#define UV_POSIX_SERIAL
+
+#include <vector>
+
+// milliseconds read() waits for bytes readCount() promised before giving up on them
+#ifndef UV_POSIX_READ_WAIT
+#define UV_POSIX_READ_WAIT 10
+#endif
+// what writeCount() offers, less whatever the kernel still has queued
+#ifndef UV_POSIX_TX_BUFFER
+#define UV_POSIX_TX_BUFFER 4096
+#endif
+
+/*
+    Non-blocking termios port. readCount() and writeCount() ask the kernel (FIONREAD and TIOCOUTQ), and reads and
+    writes go straight to the file descriptor. Anything the kernel won't take is held until it will, and writeCount()
+    stays at zero until it has gone, so frames are never cut short. flush() only pushes that out, it never blocks.
+    At most tx_buffer bytes are held. A caller that writes more than writeCount() offered loses the rest, counted in overruns.
+*/
+class PosixSerialPort : public UAVSerialPort {
+    protected:
+        int                     _fd;
+        bool                    _owner;
+        std::vector<uint8_t>    _pending;
+        bool drain();
+    public:
+        uint32_t    errors = 0;     // read and write failures other than would-block, and short reads
+        uint32_t    overruns = 0;   // bytes written while tx_buffer bytes were already held, and lost
+        int         tx_buffer = UV_POSIX_TX_BUFFER;
+        // open a device in raw 8N1 mode
+        PosixSerialPort(const char* path, uint32_t baud = 115200);
+        // wrap a descriptor that is already open. it is made non-blocking, and closed with the port if owner.
+        PosixSerialPort(int fd, bool owner);
+        ~PosixSerialPort();
+        bool is_open() { return _fd>=0; }
+        int fd() { return _fd; }
+        void read(uint8_t *buffer, int count) override;
+        void write(uint8_t *buffer, int count) override;
+        void flush() override;
+        int readCount() override;
+        int writeCount() override;
+        // put a descriptor into raw mode at a baud rate. false if the rate isn't supported or it isn't a terminal.
+        static bool configure(int fd, uint32_t baud);
+        // open a pseudo-terminal and return its master end. the slave's path goes in name, for another program or port to open.
+        static PosixSerialPort* open_pty(char* name, int size);
+};
+
+#endif
+#endif
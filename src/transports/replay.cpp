@@ -0,0 +1,148 @@
+#include "replay.h"
+
+#ifdef UV_REPLAY_FILES
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+ReplaySerialPort::ReplaySerialPort(const uint8_t* data, size_t size, bool timed) {
+    _data = data;
+    _size = size;
+    this->timed = timed;
+    rewind();
+}
+
+#ifdef UV_REPLAY_FILES
+ReplaySerialPort::ReplaySerialPort(const char* path, bool timed) : ReplaySerialPort(nullptr, 0, timed) {
+    int fd = ::open(path, O_RDONLY);
+    if(fd<0) return;
+    struct stat st;
+    if( (fstat(fd, &st)==0) && (st.st_size>0) ) {
+        void* map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(map!=MAP_FAILED) {
+            // it's read front to back
+            madvise(map, st.st_size, MADV_SEQUENTIAL);
+            _map = map;
+            _data = (const uint8_t*)map;
+            _size = st.st_size;
+        }
+    }
+    // the mapping outlives the descriptor
+    ::close(fd);
+    rewind();
+}
+#endif
+
+ReplaySerialPort::~ReplaySerialPort() {
+#ifdef UV_REPLAY_FILES
+    if(_map!=nullptr) munmap(_map, _size);
+#endif
+}
+
+void ReplaySerialPort::rewind() {
+    _capture = (_size>=UV_CAPTURE_MAGIC_SIZE) && (memcmp(_data, UV_CAPTURE_MAGIC, UV_CAPTURE_MAGIC_SIZE)==0);
+    _pos = _capture ? UV_CAPTURE_MAGIC_SIZE : 0;
+    _remain = _capture ? 0 : _size;
+    _at_us = 0;
+    _base_us = 0;
+    _started = false;
+    bytes_read = 0;
+    bytes_written = 0;
+    elapsed_us = 0;
+}
+
+bool ReplaySerialPort::next() {
+    // find the next record for our direction, keeping track of the time
+    while(_remain==0) {
+        if(!_capture || (_pos>=_size)) return false;
+        uint8_t kind = _data[_pos];
+        uint64_t delta, length;
+        int n = SerialTransport::decode_varint(&_data[_pos+1], _size-_pos-1, &delta);
+        int m = (n>0) ? SerialTransport::decode_varint(&_data[_pos+1+n], _size-_pos-1-n, &length) : 0;
+        if(m==0) {
+            // a truncated capture ends here
+            _pos = _size;
+            return false;
+        }
+        _pos += 1 + n + m;
+        _at_us += delta;
+        if(kind==UV_CAPTURE_LOST) continue;
+        length = min((uint64_t)(_size-_pos), length);
+        if(kind==direction) {
+            _remain = length;
+        } else {
+            _pos += length;
+        }
+    }
+    return true;
+}
+
+void ReplaySerialPort::begin() {
+    // the clock starts with the first record, however long the capture ran before it
+    _start = micros();
+    _base_us = _at_us;
+    _started = true;
+}
+
+int ReplaySerialPort::readCount() {
+    if(!next()) return 0;
+    if(!_started) begin();
+    // not due yet?
+    if( timed && _capture && ((uint32_t)(micros() - _start) < _at_us - _base_us) ) return 0;
+    return (int)min(_remain, (size_t)0x7FFFFFFF);
+}
+
+void ReplaySerialPort::read(uint8_t *buffer, int count) {
+    if(!_started && next()) begin();
+    while( (count>0) && next() ) {
+        int n = (int)min(_remain, (size_t)count);
+        memcpy(buffer, &_data[_pos], n);
+        buffer += n;
+        count -= n;
+        _pos += n;
+        _remain -= n;
+        bytes_read += n;
+    }
+    if(!next()) elapsed_us = micros() - _start;
+}
+
+void ReplaySerialPort::write(uint8_t *buffer, int count) {
+    bytes_written += count;
+}
+
+void ReplaySerialPort::flush() {
+}
+
+int ReplaySerialPort::writeCount() {
+    return UV_REPLAY_TX_BUFFER;
+}
+
+ReplayStats ReplaySerialPort::stats(SerialTransport& transport) {
+    ReplayStats s;
+    s.bytes = bytes_read;
+    s.elapsed_us = (_started && (elapsed_us==0)) ? micros() - _start : elapsed_us;
+    s.frames = transport.rx_frames;
+    s.crc_errors = transport.crc_errors;
+    s.rejected = transport.frames_rejected;
+    s.oob_bytes = transport.oob_bytes;
+    double seconds = s.elapsed_us / 1000000.0;
+    s.frames_per_s = seconds>0 ? s.frames / seconds : 0;
+    s.mb_per_s = seconds>0 ? s.bytes / seconds / 1000000.0 : 0;
+    s.transfers = 0;
+    s.heartbeats = 0;
+    return s;
+}
+
+void ReplaySerialPort::debug_stats(SerialTransport& transport) {
+    ReplayStats s = stats(transport);
+    Serial.print("replay "); Serial.print((uint32_t)s.bytes); Serial.print(" bytes in ");
+    Serial.print(s.elapsed_us); Serial.print("us, ");
+    Serial.print(s.frames); Serial.print(" frames ");
+    Serial.print((uint32_t)s.frames_per_s); Serial.print("/s ");
+    Serial.print(s.mb_per_s); Serial.print("MB/s crc errors:");
+    Serial.print(s.crc_errors); Serial.print(" rejected:");
+    Serial.print(s.rejected); Serial.print(" oob bytes:");
+    Serial.println((uint32_t)s.oob_bytes);
+}
@@ -0,0 +1,81 @@
+#ifndef LIBUAVESP_TRANSPORT_REPLAY_H_INCLUDED
+#define LIBUAVESP_TRANSPORT_REPLAY_H_INCLUDED
+
+#include "../common.h"
+#include "../transport.h"
+#include "serial.h"
+#include "capture.h"
+
+// files are mapped rather than read on linux and mac hosts
+#if defined(__linux__) || defined(__APPLE__)
+#define UV_REPLAY_FILES
+#endif
+
+// what writeCount() offers. whatever the transport writes is thrown away.
+#ifndef UV_REPLAY_TX_BUFFER
+#define UV_REPLAY_TX_BUFFER 4096
+#endif
+
+// what a replay got through, and how fast
+typedef struct {
+    uint64_t    bytes;
+    uint32_t    elapsed_us;
+    uint32_t    frames;
+    uint32_t    crc_errors;
+    uint32_t    rejected;
+    uint64_t    oob_bytes;
+    double      frames_per_s;
+    double      mb_per_s;
+    // what the node made of it. only the caller's listeners see that, so stats() leaves these at zero for it to fill in.
+    uint32_t    transfers;
+    uint32_t    heartbeats;
+} ReplayStats;
+
+/*
+    Plays a recorded byte stream into a transport, for reproducing field problems and timing the parser on real traffic.
+    The stream is either raw serial bytes, or a CaptureSerialPort capture, of which one direction is played.
+    Captures can keep their original timing, otherwise everything is offered as fast as the transport will read it.
+    The clock starts at the first read and stops when the last byte has been read.
+*/
+class ReplaySerialPort : public UAVSerialPort {
+    protected:
+        const uint8_t*  _data;
+        size_t          _size;
+        size_t          _pos;           // next byte to play
+        size_t          _remain = 0;    // bytes left in the current record
+        bool            _capture;
+        uint64_t        _at_us = 0;     // capture time of the current record
+        uint64_t        _base_us = 0;   // and of the first one played
+        uint32_t        _start = 0;
+        bool            _started = false;
+        void*           _map = nullptr;
+        bool next();
+        void begin();
+    public:
+        bool            timed;
+        uint8_t         direction = UV_CAPTURE_RX;   // which side of a capture to play
+        uint64_t        bytes_read = 0;
+        uint64_t        bytes_written = 0;
+        uint32_t        elapsed_us = 0;
+        // play a stream already in memory
+        ReplaySerialPort(const uint8_t* data, size_t size, bool timed = false);
+#ifdef UV_REPLAY_FILES
+        // map a file. is_open() is false if that failed.
+        ReplaySerialPort(const char* path, bool timed = false);
+#endif
+        ~ReplaySerialPort();
+        bool is_open() { return _data!=nullptr; }
+        bool is_capture() { return _capture; }
+        bool done() { return (_remain==0) && (_pos>=_size); }
+        void rewind();
+        void read(uint8_t *buffer, int count) override;
+        void write(uint8_t *buffer, int count) override;
+        void flush() override;
+        int readCount() override;
+        int writeCount() override;
+        // throughput so far, with the receive counters of the transport it was played into
+        ReplayStats stats(SerialTransport& transport);
+        void debug_stats(SerialTransport& transport);
+};
+
+#endif
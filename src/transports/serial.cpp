@@ -1,6 +1,12 @@
 #include "../crc32c.h"
 #include "serial.h"
 #include <map>
+#include <string.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
 
 // hardware serial port wrapper
 HardwareSerialPort::HardwareSerialPort(HardwareSerial& port) {
@@ -23,38 +29,89 @@ int HardwareSerialPort::writeCount() {
     return _port->availableForWrite();
 }
 
+// power-of-two byte ring
+
+SerialRing::SerialRing(int size) : _head(0), _tail(0) {
+    uint32_t s = 16;
+    while(s < (uint32_t)size) s <<= 1;
+    _buffer = new uint8_t[s];
+    _mask = s - 1;
+}
+SerialRing::~SerialRing() {
+    delete[] _buffer;
+}
+int SerialRing::read(uint8_t *buffer, int count) {
+    // the acquire pairs with the writer's release, so the bytes are there before we see the head move
+    uint32_t tail = _tail.load(std::memory_order_relaxed);
+    int n = min(count, (int)(_head.load(std::memory_order_acquire) - tail));
+    if(n<=0) return 0;
+    // up to the end of the buffer, then from the start
+    int offset = tail & _mask;
+    int first = min(n, (int)(_mask + 1) - offset);
+    memcpy(buffer, &_buffer[offset], first);
+    memcpy(&buffer[first], _buffer, n - first);
+    _tail.store(tail + n, std::memory_order_release);
+    return n;
+}
+int SerialRing::write(const uint8_t *buffer, int count) {
+    uint32_t head = _head.load(std::memory_order_relaxed);
+    int n = min(count, (int)(_mask + 1 - (head - _tail.load(std::memory_order_acquire))));
+    if(n<=0) return 0;
+    int offset = head & _mask;
+    int first = min(n, (int)(_mask + 1) - offset);
+    memcpy(&_buffer[offset], buffer, first);
+    memcpy(_buffer, &buffer[first], n - first);
+    _head.store(head + n, std::memory_order_release);
+    return n;
+}
+int SerialRing::readCount() {
+    return _head.load(std::memory_order_acquire) - _tail.load(std::memory_order_relaxed);
+}
+int SerialRing::writeCount() {
+    return _mask + 1 - (_head.load(std::memory_order_relaxed) - _tail.load(std::memory_order_acquire));
+}
+
 // loopback serial port
 
-LoopbackSerialPort::LoopbackSerialPort() { }
+LoopbackSerialPort::LoopbackSerialPort(int size) : _ring(size) { }
 LoopbackSerialPort::~LoopbackSerialPort() { }
 void LoopbackSerialPort::read(uint8_t *buffer, int count) {
-    int c = min(count,_count);
-    _count -= c;
-    int i = 0;
-    while(c>0) {
-        buffer[i++] = _buffer[_tail++];
-        if(_tail==_size) _tail=0;
-        c--;
-    }
+    _ring.read(buffer, count);
 }
 void LoopbackSerialPort::write(uint8_t *buffer, int count) {
-    int c = min(count,_size-_count);
-    _count += c;
-    int i = 0;
-    while(c>0) {
-        _buffer[_head++] = buffer[i++];
-        if(_head==_size) _head=0;
-        c--;
-    }
+    overruns += count - _ring.write(buffer, count);
 }
 void LoopbackSerialPort::flush() { }
 int LoopbackSerialPort::readCount() { 
-    return _count;
+    return _ring.readCount();
 }
 int LoopbackSerialPort::writeCount() { 
-    return _size-_count;
+    return _ring.writeCount();
 }
 
+// thread link serial ports
+
+SPSCSerialPort::SPSCSerialPort(SerialRing* rx, SerialRing* tx) {
+    _rx = rx;
+    _tx = tx;
+}
+SPSCSerialPort::~SPSCSerialPort() { }
+void SPSCSerialPort::read(uint8_t *buffer, int count) {
+    _rx->read(buffer, count);
+}
+void SPSCSerialPort::write(uint8_t *buffer, int count) {
+    overruns += count - _tx->write(buffer, count);
+}
+void SPSCSerialPort::flush() { }
+int SPSCSerialPort::readCount() {
+    return _rx->readCount();
+}
+int SPSCSerialPort::writeCount() {
+    return _tx->writeCount();
+}
+
+SPSCSerialLink::SPSCSerialLink(int size) : _ab(size), _ba(size), a(&_ba, &_ab), b(&_ab, &_ba) { }
+
 // debug serial port
 
 DebugSerialPort::DebugSerialPort(UAVSerialPort* port, bool owner) {
@@ -178,100 +235,209 @@ int DebugSerialPort::write_line(int wc) {
 
 // serial transport
 
-SerialTransport::SerialTransport(UAVSerialPort* port, bool owner, SerialOOBHandler oob) {
+SerialTransport::SerialTransport(UAVSerialPort* port, bool owner, SerialOOBHandler oob, int queue_depth, int rx_buffer_size) {
     _port = port;
     _owner = owner;
     oob_handler = oob;
     _rx  = new SerialFrame();
     _rx->transfer_state = UV_SERIAL_RX_STATE_NONE;
-    _rx->frame_size = UV_SERIAL_MAX_FRAME_SIZE;
+    _rx->frame_size = max(rx_buffer_size, UV_SERIAL_MIN_FRAME_SIZE);
     _rx->frame_index = 0;
-    _rx->frame_buffer = new uint8_t[UV_SERIAL_MAX_FRAME_SIZE];
+    _rx->frame_stride = 0;
+    _rx->crc = CRC32C_INITIAL;
+    _rx->frame_buffer = new uint8_t[_rx->frame_size];
     _rx->transfer = nullptr;
+    _io_buffer = new uint8_t[UV_SERIAL_IO_BUFFER_SIZE];
     _tx = NULL;
-    _queue = new NumberMap(32);
+    // all the priority queues share one block of entries, which start out on the free list
+    _queue_depth = min(max(queue_depth, 1), 0x7FFF);
+    _queue_entries = new SerialQueueEntry[_queue_depth];
+    for(int i=0; i<_queue_depth; i++) _queue_entries[i].next = (i+1<_queue_depth) ? i+1 : -1;
+    _queue_free = 0;
+    for(int i=0; i<UV_SERIAL_PRIORITIES; i++) {
+        _queues[i].head = -1;
+        _queues[i].tail = -1;
+        _queues[i].count = 0;
+    }
+    _queued = 0;
+    _blocked = 0;
+    for(int i=0; i<UV_SERIAL_MAX_SESSIONS; i++) {
+        _sessions[i].active = false;
+        _sessions[i].buffer = nullptr;
+    }
+    for(int i=0; i<UV_SERIAL_DICT_RX_SIZE; i++) _dict_rx[i].used = false;
 }
 
 SerialTransport::~SerialTransport() {
-    for(int i=0; i<_queue->count; i++) delete _queue->values[i];
-    delete _queue;
-    delete _rx->frame_buffer;
+    if(_tx!=NULL) _tx->transfer->unref();
+    UAVTransfer* transfer;
+    while( (transfer = dequeue()) != nullptr ) transfer->unref();
+    delete[] _queue_entries;
+    for(int i=0; i<UV_SERIAL_MAX_SESSIONS; i++) session_end(&_sessions[i]);
+    delete[] _rx->frame_buffer;
+    delete[] _io_buffer;
     delete _rx;
     if(_owner) delete _port;
 }
 
 void SerialTransport::loop(UAVNode& node, const unsigned long t, const int dt) {
-    // is there rx data available?
+    // drop any multi-frame receptions that have stalled
+    _now = t;
+    session_expire(&node, t);
+    uint32_t start = (time_budget>0) ? micros() : 0;
+    bool timeout = false;
+    // read and parse what's available, up to the read budget
+    int budget = read_budget;
     int remain = _port->readCount();
-    while(remain>0) {
-        // Serial.print("<"); Serial.print(remain); Serial.print(">");
+    while( (remain>0) && (budget>0) && !timeout ) {
         // bulk read a block
-        uint8_t buf[64];
-        remain = min(64,remain);
-        _port->read(buf,remain);
+        remain = min(min(UV_SERIAL_IO_BUFFER_SIZE, remain), budget);
+        _port->read(_io_buffer, remain);
+        budget -= remain;
+        rx_bytes += remain;
         // parse the byte stream into a transfer buffer
-        SerialTransport::parse_buffer(buf, remain, &node);
+        SerialTransport::parse_buffer(_io_buffer, remain, &node);
+        if(time_budget>0) timeout = (uint32_t)(micros() - start) >= time_budget;
         // any left?
         remain = _port->readCount();
     }
-    // is there ample space in the serial port tx buffer?
-    remain = _port->writeCount();
-    if(remain>=16) {
-        // bulk write a block
-        uint8_t buf[remain];
-        int count=0;
-        // are we ready to start the next transmit?
-        if( (_tx==NULL) && (_queue->count>0) ){
-            // start a new transfer
-            _tx = (SerialFrame *)_queue->values[0];
-            // send the frame start delimiter
+    // stopped early with data still waiting?
+    bool throttled_now = (remain>0);
+    // build the hello now we know our node id. it goes out ahead of the next transfer.
+    if( _hello_due && (node.local_node_id!=0xFFFF) ) {
+        _hello_size = encode_hello(_hello, node.local_node_id);
+        _hello_tries++;
+        _hello_time = t;
+        hellos++;
+    }
+    _hello_due = false;
+    // write queued frames while there's ample space in the port, up to the write budget
+    budget = write_budget;
+    bool sent = false;
+    while( (budget>0) && !timeout && ((_tx!=NULL) || (_queued!=0) || (_hello_size>0)) ) {
+        remain = min(min(UV_SERIAL_IO_BUFFER_SIZE, _port->writeCount()), budget);
+        if(remain<16) break;
+        int count = write_frames(_io_buffer, remain, sent);
+        if(count==0) break;
+        _port->write(_io_buffer, count);
+        budget -= count;
+        tx_bytes += count;
+        if(time_budget>0) timeout = (uint32_t)(micros() - start) >= time_budget;
+    }
+    // flush once if any frames were completed
+    if(sent) _port->flush();
+    // the write loop gives up with less than 16 bytes of budget left, so that counts as spent
+    if( (budget<16) || timeout ) throttled_now |= (_tx!=NULL) || (_queued!=0);
+    if(throttled_now) throttled++;
+    // tell producers that found the queue full that it now has room
+    if( (_blocked!=0) && (_queue_free>=0) ) {
+        for(int p=0; p<UV_SERIAL_PRIORITIES; p++) {
+            if(_blocked & (1<<p)) {
+                _blocked &= ~(1<<p);
+                if(node.on_writable) node.on_writable(this, p);
+            }
+        }
+    }
+}
+int SerialTransport::write_frames(uint8_t* buf, int remain, bool& sent) {
+    int count = 0;
+    // keep going while there's room, so queued frames go out back to back
+    while(remain>1) {
+        // a hello is tiny, so it goes out whole between transfers
+        if( (_tx==NULL) && (_hello_size>0) ) {
+            if(remain < 2*_hello_size + 2) break;
+            if(!sent) {
+                buf[count++] = UV_SERIAL_FRAME_DELIMITER;
+                remain--;
+            }
+            for(int i=0; i<_hello_size; i++) {
+                uint8_t c = _hello[i];
+                if( (c==UV_SERIAL_FRAME_DELIMITER) || (c==UV_SERIAL_ESCAPE_PREFIX) ) {
+                    buf[count++] = UV_SERIAL_ESCAPE_PREFIX;
+                    c ^= 0xFF;
+                    remain--;
+                }
+                buf[count++] = c;
+                remain--;
+            }
             buf[count++] = UV_SERIAL_FRAME_DELIMITER;
             remain--;
+            _hello_size = 0;
+            sent = true;
+            continue;
         }
-        // do we have a tx in progress
-        if(_tx!=NULL) {
-            uint8_t c;
-            int fi = _tx->frame_index;
-            int fr = _tx->frame_size - fi;
-            // while there's data and we have buffer space
-            while( (remain>1) && (fr>0) ) {
-                // consume one byte from the transmit buffer
-                c = _tx->frame_buffer[fi++];
-                fr--;
-                // is it an escaped character?
-                switch(c) {
-                    case UV_SERIAL_FRAME_DELIMITER:
-                    case UV_SERIAL_ESCAPE_PREFIX:
-                        // escape the byte
-                        buf[count++] = UV_SERIAL_ESCAPE_PREFIX;
-                        buf[count++] = c ^ 0xFF;
-                        remain -= 2;
-                        break;
-                    default:
-                        // write the byte unmodified
-                        buf[count++] = c;
-                        remain--;
-                        break;
-                }
+        // are we ready to start the next transmit?
+        if( (_tx==NULL) && (_queued!=0) ){
+            // start a new transfer, taking over the queue's reference
+            UAVTransfer* transfer = dequeue();
+            _tx = &_tx_frame;
+            _tx->transfer = transfer;
+            _tx->frame_size = transfer->frame_size;
+            _tx->frame_index = 0;
+            _tx->frame_stride = transfer->frame_stride;
+            // single frames go out compact if the link allows it. the header depends on this link's dictionary, so it's built here.
+            _tx_compact_size = 0;
+            if(use_compact(transfer)) {
+                _tx_compact_size = encode_compact(_tx_compact, transfer);
+                _tx->frame_size = _tx_compact_size + transfer->payload_size + UV_SERIAL_CRC_SIZE;
+                _tx->frame_stride = 0;
             }
-            // have we finished the transfer (and have space to write our end delimeter?)
-            if( (remain>0) && (fr==0) ) {
-                // send the frame end delimiter
+            // send the frame start delimiter, unless we just wrote an end delimiter it can share
+            if(!sent) {
                 buf[count++] = UV_SERIAL_FRAME_DELIMITER;
-                // and flush the output
-                _port->write(buf,count);
-                _port->flush();
-                // dequeue the transfer
-                _tx = NULL;
-                dequeue(0);
-            } else {
-                // write what we got
-                _port->write(buf,count);
-                // store the index for next time
+                remain--;
+            }
+        }
+        // do we have a tx in progress
+        if(_tx==NULL) break;
+        uint8_t c;
+        int fi = _tx->frame_index;
+        // multi-frame buffers are sent up to the end of the current frame
+        int end = _tx->frame_size;
+        if(_tx->frame_stride>0) end = min(end, (fi / _tx->frame_stride + 1) * _tx->frame_stride);
+        int fr = end - fi;
+        // while there's data and we have buffer space
+        while( (remain>1) && (fr>0) ) {
+            // the frame is gathered from its header, the payload and its trailer
+            int length;
+            uint8_t* segment = tx_segment(fi, &length);
+            // copy the run of bytes that need no escaping in one go, keeping a byte spare for the delimiter
+            int run = clean_run(segment, min(min(fr, length), remain-1));
+            if(run>0) {
+                memcpy(&buf[count], segment, run);
+                count += run; fi += run; fr -= run; remain -= run;
+                continue;
+            }
+            // the next byte is a delimiter or escape prefix, escape it
+            c = *segment;
+            fi++;
+            fr--;
+            buf[count++] = UV_SERIAL_ESCAPE_PREFIX;
+            buf[count++] = c ^ 0xFF;
+            remain -= 2;
+        }
+        // have we finished the transfer (and have space to write our end delimeter?)
+        if( (remain>0) && (fr==0) ) {
+            // send the frame end delimiter
+            buf[count++] = UV_SERIAL_FRAME_DELIMITER;
+            remain--;
+            // more frames in this transfer? the delimiter we just wrote also starts the next one
+            if(fi < _tx->frame_size) {
                 _tx->frame_index = fi;
+                continue;
             }
+            // done with the transfer, this may complete it
+            _tx->transfer->sent();
+            _tx->transfer->unref();
+            _tx = NULL;
+            sent = true;
+        } else {
+            // store the index for next time
+            _tx->frame_index = fi;
+            break;
         }
     }
+    return count;
 }
 
 void SerialTransport::parse_buffer(uint8_t* parse, int count, UAVNode* node) {
@@ -279,6 +445,7 @@ void SerialTransport::parse_buffer(uint8_t* parse, int count, UAVNode* node) {
     int state = _rx->transfer_state;
     int index = _rx->frame_index;
     int size  = _rx->frame_size;
+    uint32_t crc = _rx->crc;
     uint8_t* frame = _rx->frame_buffer;
 
     // parse buffer properties
@@ -294,6 +461,8 @@ void SerialTransport::parse_buffer(uint8_t* parse, int count, UAVNode* node) {
 
     // character variable, used a lot
     uint8_t ch; 
+    bool escaped;
+    int run;
     
     while(remain>0) {
         //Serial.print(state);  Serial.print(".");
@@ -319,9 +488,20 @@ void SerialTransport::parse_buffer(uint8_t* parse, int count, UAVNode* node) {
                 }
                 // send known oob fragment to the handler
                 if(oob_size>0) {
+                    oob_bytes += oob_size;
                     if(oob_handler!=nullptr) oob_handler(this, _rx, oob_start, oob_size);
                 }
                 break;
+            case UV_SERIAL_RX_STATE_SKIP:
+                // a rejected frame. discard everything up to the next delimiter
+                while(remain>0) {
+                    ch = *p++; remain--;
+                    if(ch == UV_SERIAL_FRAME_DELIMITER) {
+                        state = UV_SERIAL_RX_STATE_DELIMITER;
+                        break;
+                    }
+                }
+                break;
             case UV_SERIAL_RX_STATE_DELIMITER:
                 // we have just seen a delimeter. we may see more.
                 while(remain>0) {
@@ -331,14 +511,23 @@ void SerialTransport::parse_buffer(uint8_t* parse, int count, UAVNode* node) {
                     if(ch == UV_SERIAL_FRAME_DELIMITER) {
                         // consume it, stay in this state.
                         p++; remain--; 
-                    } else if(ch == UV_SERIAL_FRAME_VERSION_0) {
-                        // we can try to parse it as a v0 frame, 
+                    } else if( (ch == UV_SERIAL_FRAME_VERSION_0) || (ch == UV_SERIAL_FRAME_VERSION_1) ) {
+                        // a whole frame with nothing escaped can be decoded straight from the read buffer
+                        run = clean_run(p, remain);
+                        if( (run<remain) && (p[run]==UV_SERIAL_FRAME_DELIMITER) && (run>=UV_SERIAL_COMPACT_MIN_FRAME_SIZE) && (run<=size) ) {
+                            decode_direct(p, run, node);
+                            // consume it and its end delimiter, staying in this state
+                            p += run+1; remain -= run+1;
+                            continue;
+                        }
+                        // we can try to parse it as a frame, 
                         // timestamp the tramsfer start here
                         // auto timestamp = node->get_time_us();
                         // save that timestamp in the transfer metadata
                         // ...
-                        // switch to that state and reprocess 
+                        // switch to that state and reprocess, with the header crc starting fresh
                         state = UV_SERIAL_RX_STATE_FRAME;
+                        crc = CRC32C_INITIAL;
                         break;
                     } else {
                         // not a recognized protocol frame type. we are now out-of-band
@@ -348,72 +537,178 @@ void SerialTransport::parse_buffer(uint8_t* parse, int count, UAVNode* node) {
                     }
                 }
                 break;
-            case  UV_SERIAL_RX_STATE_FRAME:
-                // parse data into the frame buffer as fast as possible
+            case UV_SERIAL_RX_STATE_FRAME:
+            case UV_SERIAL_RX_STATE_ESCAPE:
+                // did the last parse end with an escape code cliffhanger?
+                escaped = (state == UV_SERIAL_RX_STATE_ESCAPE);
+                state = UV_SERIAL_RX_STATE_FRAME;
+                // parse data into the frame buffer as fast as possible, checking the crc as we go
                 while(remain>0) {
-                    // consume next character
-                    ch = *p++; remain--; 
-                    // it the escape code?
-                    if(ch == UV_SERIAL_ESCAPE_PREFIX) {
-                        // is the next character available right now?
-                        if(remain>0) {
-                            // consume next character too
-                            ch = *p++; remain--;
+                    // copy runs of ordinary bytes in bulk, stopping at the end of the header so it can be checked
+                    run = 0;
+                    if(!escaped) {
+                        run = min(remain, frame_remain);
+                        if(index < UV_SERIAL_HEADER_WITH_CRC_SIZE) run = min(run, UV_SERIAL_HEADER_WITH_CRC_SIZE - index);
+                        run = clean_run(p, run);
+                    }
+                    if(run>0) {
+                        for(int i=0; i<run; i++) {
+                            ch = p[i];
+                            fp[i] = ch;
+                            crc = crc32c_add(crc, ch);
+                        }
+                        p += run; remain -= run;
+                        fp += run; index += run; frame_remain -= run;
+                    } else {
+                        // consume next character
+                        ch = *p++; remain--; 
+                        if(escaped) {
                             // de-escape data for the frame buffer
-                            if(frame_remain>0) { *fp++ = ch^0xFF; index++; frame_remain--; } 
-                        } else {
-                            // no more for now, switch state for the next parse
-                            state = UV_SERIAL_RX_STATE_ESCAPE;
+                            ch ^= 0xFF;
+                            escaped = false;
+                        } else if(ch == UV_SERIAL_ESCAPE_PREFIX) {
+                            // the next character is the escaped one
+                            escaped = true;
+                            continue;
+                        } else if(ch == UV_SERIAL_FRAME_DELIMITER) {
+                            //Serial.print("} "); 
+                            // end of frame. if we had any frame data update the frame
+                            if(index>0) {
+                                // then attempt to decode the frame content and process it through the node
+                                decode_frame(frame, index, crc, node);
+                                // clear the recieve buffer state for the next frame
+                                fp = frame; index = 0; frame_remain = size;
+                            }
+                            //Serial.print(" { ");
+                            // switch state to where missing one of the delimiters is acceptable
+                            state = UV_SERIAL_RX_STATE_DELIMITER;
+                            break;
                         }
-                    // is it a frame delimeter
-                    } else if(ch == UV_SERIAL_FRAME_DELIMITER) {
-                        //Serial.print("} "); 
-                        // end of frame. if we had any frame data update the frame
-                        if(index>0) {
-                            // then attempt to decode the frame content and process it through the node
-                            _rx->frame_index = index;
-                            decode_frame(_rx,node);
-                            // clear the recieve buffer state for the next frame
+                        // it must be more data for the frame. is there room for it?
+                        if(frame_remain==0) {
+                            frames_rejected++;
                             fp = frame; index = 0; frame_remain = size;
+                            state = UV_SERIAL_RX_STATE_SKIP;
+                            break;
                         }
-                        //Serial.print(" { ");
-                        // switch state to where missing one of the delimiters is acceptable
-                        state = UV_SERIAL_RX_STATE_DELIMITER;
-                        break;
-                    } else {
-                        // it must be more data for the frame
-                        if(frame_remain>0) { *fp++ = ch; index++; frame_remain--; }
+                        *fp++ = ch; index++; frame_remain--;
+                        crc = crc32c_add(crc, ch);
+                    }
+                    // once a v0 header is complete, decide if the rest of the frame is worth buffering. compact frames have one crc at the end.
+                    if( (index == UV_SERIAL_HEADER_WITH_CRC_SIZE) && (frame[0] == UV_SERIAL_FRAME_VERSION_0) ) {
+                        if(!header_accept(frame, crc, node)) {
+                            frames_rejected++;
+                            fp = frame; index = 0; frame_remain = size;
+                            state = UV_SERIAL_RX_STATE_SKIP;
+                            break;
+                        }
+                        // the payload crc starts fresh
+                        crc = CRC32C_INITIAL;
                     }
                 }
-                break;
-            case  UV_SERIAL_RX_STATE_ESCAPE:
-                // this should only happen if the last parse ended with an escape code cliffhanger
-                // consume one character
-                ch = *p++; remain--;
-                // de-escape character code to the frame
-                if(frame_remain>0) { *fp++ = ch^0xFF; index++; frame_remain--; }
-                // back to regular frame parse state for the rest
-                state = UV_SERIAL_RX_STATE_FRAME;
+                if(escaped) state = UV_SERIAL_RX_STATE_ESCAPE;
                 break;
         }
     }
     // store the locals back into the frame state
     _rx->transfer_state = state;
     _rx->frame_index = index;
+    _rx->crc = crc;
 }
 
-void SerialTransport::encode_frame(UAVTransfer* transfer) { 
-    // how big a transfer buffer will we need?
-    int size = UV_SERIAL_MIN_FRAME_SIZE + transfer->payload_size;
-    // allocate a buffer for it
-    uint8_t* buffer = new uint8_t[size];
+int SerialTransport::clean_run(const uint8_t* data, int size) {
+    // the delimiter and escape prefix only differ in one bit, so setting that bit maps both onto the same value
+    const uint8_t diff = UV_SERIAL_FRAME_DELIMITER ^ UV_SERIAL_ESCAPE_PREFIX;
+    const uint8_t special = UV_SERIAL_FRAME_DELIMITER | UV_SERIAL_ESCAPE_PREFIX;
+    int i = 0;
+#if defined(__SSE2__)
+    // 16 bytes at a time
+    const __m128i bit = _mm_set1_epi8(diff);
+    const __m128i match = _mm_set1_epi8(special);
+    for(; i+16<=size; i+=16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)&data[i]);
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_or_si128(v, bit), match));
+        if(mask!=0) return i + __builtin_ctz(mask);
+    }
+#elif defined(__ARM_NEON)
+    // 16 bytes at a time, narrowing the compare result to a nibble per byte
+    const uint8x16_t bit = vdupq_n_u8(diff);
+    const uint8x16_t match = vdupq_n_u8(special);
+    for(; i+16<=size; i+=16) {
+        uint8x16_t eq = vceqq_u8(vorrq_u8(vld1q_u8(&data[i]), bit), match);
+        uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(eq), 4)), 0);
+        if(mask!=0) return i + __builtin_ctzll(mask)/4;
+    }
+#else
+    // 4 bytes at a time. align first, since the esp8266 can't load unaligned words
+    while( (i<size) && (((uintptr_t)&data[i]) & 3) ) {
+        if((data[i] | diff) == special) return i;
+        i++;
+    }
+    for(; i+4<=size; i+=4) {
+        uint32_t w;
+        memcpy(&w, &data[i], 4);
+        // zero bytes in x are the special ones
+        uint32_t x = (w | (0x01010101 * diff)) ^ (0x01010101 * special);
+        if( ((x - 0x01010101) & ~x & 0x80808080) != 0 ) break;
+    }
+#endif
+    // finish byte by byte
+    for(; i<size; i++) {
+        if((data[i] | diff) == special) return i;
+    }
+    return size;
+}
+
+void SerialTransport::decode_direct(uint8_t* frame, int size, UAVNode* node) {
+    if(frame[0] == UV_SERIAL_FRAME_VERSION_1) {
+        decode_frame(frame, size, crc32c_update(CRC32C_INITIAL, frame, size), node);
+        return;
+    }
+    if(size < UV_SERIAL_MIN_FRAME_SIZE) return;
+    // the same checks the copying path makes as bytes arrive
+    uint32_t crc = crc32c_update(CRC32C_INITIAL, frame, UV_SERIAL_HEADER_WITH_CRC_SIZE);
+    if(!header_accept(frame, crc, node)) {
+        frames_rejected++;
+        return;
+    }
+    crc = crc32c_update(CRC32C_INITIAL, &frame[UV_SERIAL_HEADER_WITH_CRC_SIZE], size - UV_SERIAL_HEADER_WITH_CRC_SIZE);
+    decode_frame(frame, size, crc, node);
+}
+
+bool SerialTransport::header_accept(uint8_t* header, uint32_t crc, UAVNode* node) {
+    // the header and its crc together leave the crc residue
+    if(crc != CRC32C_RESIDUE) {
+        crc_errors++;
+        return false;
+    }
+    peer_heard(UAVTransport::decode_uint16(&header[2]));
+    // a peer sending compact frames only sends version 0 for transfers that take several frames. a single one means
+    // it has stopped, eg. rebooted into older firmware, so go back to version 0 ourselves and start offering again.
+    if( _peer_sends_compact && (UAVTransport::decode_uint32(&header[24]) == UV_SERIAL_FRAME_EOT) ) {
+        _peer_compact = false;
+        _peer_sends_compact = false;
+        _hello_tries = 0;
+    }
+    // a peer still sending version 0 may not know we can take compact frames. tell it, backing off, and give up after a few.
+    if( (compact!=UV_SERIAL_COMPACT_OFF) && !_peer_compact && !_peer_shared && (_hello_tries < UV_SERIAL_HELLO_TRIES) ) {
+        if( (_hello_tries==0) || ((uint32_t)(_now - _hello_time) >= ((uint32_t)UV_SERIAL_HELLO_INTERVAL << (_hello_tries-1))) ) _hello_due = true;
+    }
+    // is it addressed to us, or everyone?
+    if(!promiscuous) {
+        uint16_t dst_node_id = UAVTransport::decode_uint16(&header[4]);
+        if( (dst_node_id != 0xFFFF) && (dst_node_id != node->local_node_id) ) return false;
+    }
+    return true;
+}
+
+void SerialTransport::encode_header(uint8_t* buffer, UAVTransfer* transfer, uint32_t frame_index) {
     // header data
     uint16_t sid = transfer->local_node_id;
     uint16_t did = transfer->remote_node_id;
     uint16_t dataspec = transfer->port_id;
     uint64_t transfer_id = transfer->transfer_id;
     uint64_t datatype = transfer->datatype;
-    uint32_t frame_index = (1<<31);
     switch(transfer->transfer_kind) {
         case UAVTransfer::UAVTransfer::KindRequest: dataspec |= (1<<15); break;
         case UAVTransfer::UAVTransfer::KindResponse: dataspec |= (1<<15) | (1<<14); break;
@@ -429,44 +724,70 @@ void SerialTransport::encode_frame(UAVTransfer* transfer) {
     UAVTransport::encode_uint32(&buffer[24], frame_index);
     // crc the header
     UAVTransport::encode_uint32(&buffer[28], crc32c(buffer,UV_SERIAL_HEADER_WITHOUT_CRC_SIZE) );
-    // copy the payload
-    memcpy(&buffer[32], transfer->payload, transfer->payload_size);
-    // crc the payload
-    UAVTransport::encode_uint32(&buffer[32+transfer->payload_size], crc32c(&buffer[32],transfer->payload_size) );
-    // store the transfer frame
-    transfer->frame_data = buffer;
-    transfer->frame_size = size;
-}
-
-bool SerialTransport::decode_frame(SerialFrame* rx, UAVNode *node) {
-    int index = rx->frame_index;
-    uint8_t* buffer = rx->frame_buffer;
-    // do we have enough data for a minimum frame?
-    if(index < UV_SERIAL_MIN_FRAME_SIZE) return false;
+}
+
+void SerialTransport::encode_frame(UAVTransfer* transfer) { 
+    // the payload is sent straight from the transfer, so it has to live as long as the transfer does.
+    // reserved payloads already do, lent ones are copied in here.
+    transfer->keep_payload();
+    // each frame is a header, a slice of the payload and a crc trailer. only the headers and trailers are stored, side by side.
+    int count = 1;
+    if(transfer->payload_size > UV_SERIAL_MAX_PAYLOAD_SIZE) count = (transfer->payload_size + UV_SERIAL_MAX_PAYLOAD_SIZE - 1) / UV_SERIAL_MAX_PAYLOAD_SIZE;
+    uint8_t* segments = transfer->frame_alloc(count * UV_SERIAL_MIN_FRAME_SIZE);
+    int remain = transfer->payload_size;
+    uint8_t* payload = transfer->payload;
+    for(int i=0; i<count; i++) {
+        uint8_t* header = &segments[i * UV_SERIAL_MIN_FRAME_SIZE];
+        int chunk = min(remain, UV_SERIAL_MAX_PAYLOAD_SIZE);
+        remain -= chunk;
+        // the frame index counts up, with the end-of-transfer bit on the last one. a single frame is both first and last.
+        encode_header(header, transfer, i | (remain==0 ? UV_SERIAL_FRAME_EOT : 0));
+        UAVTransport::encode_uint32(&header[UV_SERIAL_HEADER_WITH_CRC_SIZE], crc32c(payload, chunk) );
+        payload += chunk;
+    }
+    // store the transfer frames
+    transfer->frame_data = segments;
+    transfer->frame_size = count * UV_SERIAL_MIN_FRAME_SIZE + transfer->payload_size;
+    transfer->frame_stride = (count>1) ? UV_SERIAL_MAX_FRAME_SIZE : 0;
+}
+uint8_t* SerialTransport::frame_segment(UAVTransfer* transfer, int index, int* length) {
+    // which frame, and how far into it
+    int frame = 0;
+    int offset = index;
+    if(transfer->frame_stride>0) {
+        frame = index / transfer->frame_stride;
+        offset = index % transfer->frame_stride;
+    }
+    uint8_t* header = &transfer->frame_data[frame * UV_SERIAL_MIN_FRAME_SIZE];
+    int start = frame * UV_SERIAL_MAX_PAYLOAD_SIZE;
+    int chunk = min((int)transfer->payload_size - start, UV_SERIAL_MAX_PAYLOAD_SIZE);
+    // header, payload slice, then trailer
+    if(offset < UV_SERIAL_HEADER_WITH_CRC_SIZE) {
+        *length = UV_SERIAL_HEADER_WITH_CRC_SIZE - offset;
+        return &header[offset];
+    }
+    offset -= UV_SERIAL_HEADER_WITH_CRC_SIZE;
+    if(offset < chunk) {
+        *length = chunk - offset;
+        return &transfer->payload[start + offset];
+    }
+    offset -= chunk;
+    *length = UV_SERIAL_CRC_SIZE - offset;
+    return &header[UV_SERIAL_HEADER_WITH_CRC_SIZE + offset];
+}
+bool SerialTransport::decode_frame(uint8_t* buffer, int index, uint32_t crc, UAVNode *node) {
     // is this a known version?
+    if(buffer[0] == UV_SERIAL_FRAME_VERSION_1) return decode_compact(buffer, index, crc, node);
     if(buffer[0] == UV_SERIAL_FRAME_VERSION_0) {
+        // do we have enough data for a minimum frame?
+        if(index < UV_SERIAL_MIN_FRAME_SIZE) return false;
         // get pointers and payload size
         uint8_t * header = buffer;
-        uint8_t * header_crc = &buffer[UV_SERIAL_HEADER_WITHOUT_CRC_SIZE];
         uint8_t * payload = &buffer[UV_SERIAL_HEADER_WITH_CRC_SIZE];
-        uint8_t * payload_crc = &buffer[index - UV_SERIAL_CRC_SIZE];
         int payload_size = index - UV_SERIAL_HEADER_WITH_CRC_SIZE - UV_SERIAL_CRC_SIZE;
-        // check header crc
-        uint32_t h_crc = crc32c(header, UV_SERIAL_HEADER_WITHOUT_CRC_SIZE);
-        uint32_t header_crc_value = UAVTransport::decode_uint32(header_crc);
-        if(h_crc != header_crc_value) {
-            // failed header crc
-            return false;
-        }
-        // check payload crc
-        uint32_t p_crc = crc32c(payload, payload_size);
-        uint32_t payload_crc_value = UAVTransport::decode_uint32(payload_crc);
-        if(p_crc != payload_crc_value) {
-            // failed payload crc
-            return false;
-        }
+        // the header crc was checked as it arrived
         // decode priority
-        UAVPriority priority = (UAVPriority)header[1];
+        UAVPriority priority = header[1] & UV_SERIAL_COMPACT_PRIORITY;
         // decode node ids
         uint16_t src_node_id = UAVTransport::decode_uint16(&header[2]);
         uint16_t dst_node_id = UAVTransport::decode_uint16(&header[4]);
@@ -483,19 +804,22 @@ bool SerialTransport::decode_frame(SerialFrame* rx, UAVNode *node) {
             } else {
                 kind = UAVTransfer::KindResponse;
             }
-            port_id = dataspec & 0x3FFF;
+            port_id = (dataspec & 0x3FFF) | 0x8000;
         }
         // decode datatype
         uint64_t datatype  = UAVTransport::decode_uint64(&header[8]);
+        // check payload crc, which was also run as the payload arrived. the header is good, so the failure can be charged to the port
+        if(crc != CRC32C_RESIDUE) {
+            // failed payload crc
+            crc_errors++;
+            node->transfer_error(port_id, datatype);
+            return false;
+        }
         // decode transfer id
         uint64_t transfer_id  = UAVTransport::decode_uint64(&header[16]);
         // decode frame index
         uint32_t frame_index  = UAVTransport::decode_uint32(&header[24]);
-        // we only accept single-frame transfer at this time
-        if(frame_index != (1<<31)) {
-            Serial.print("badframe ");
-            return false;
-        }
+        rx_frames++;
         // the frame seems to be well formed. wrap it in a transfer header structure
         UAVTransfer transfer;
         transfer.timestamp_usec = 0;
@@ -508,6 +832,8 @@ bool SerialTransport::decode_frame(SerialFrame* rx, UAVNode *node) {
         transfer.transfer_id = transfer_id;
         transfer.payload_size = payload_size;
         transfer.payload = payload;
+        // part of a multi-frame transfer? collect it in a session until the last frame arrives
+        if(frame_index != UV_SERIAL_FRAME_EOT) return reassemble(node, transfer, frame_index);
         // pass it to the node transfer reciever, this may cause a lot of activity.
         node->transfer_receive(&transfer);
         // the transfer is considered complete at this time, the transfer wrapper is destroyed and the buffer is recycled
@@ -517,39 +843,401 @@ bool SerialTransport::decode_frame(SerialFrame* rx, UAVNode *node) {
     return false;
 }
 
-void SerialTransport::send(UAVTransfer* transfer) {
+bool SerialTransport::use_compact(UAVTransfer* transfer) {
+    if(transfer->payload_size > UV_SERIAL_MAX_PAYLOAD_SIZE) return false;
+    // receivers only keep a few dictionaries, so a segment with many talkers would thrash them
+    return (compact==UV_SERIAL_COMPACT_ON) || ( (compact==UV_SERIAL_COMPACT_AUTO) && _peer_compact && !_peer_shared );
+}
+
+void SerialTransport::peer_heard(UAVNodeID src_node_id) {
+    if(src_node_id==0xFFFF) return;
+    if(_peer!=src_node_id) {
+        // a different sender. what we knew about the last one doesn't hold for this one.
+        if(_peer!=0xFFFF) {
+            _peer_shared = true;
+            _peer_changed = _now;
+        }
+        _peer = src_node_id;
+        _peer_compact = false;
+        _peer_sends_compact = false;
+        _hello_tries = 0;
+    } else if( _peer_shared && ((uint32_t)(_now - _peer_changed) >= UV_SERIAL_PEER_TIMEOUT) ) {
+        // only this one has been heard for a while, eg. the peer came back with a new node id
+        _peer_shared = false;
+    }
+}
+
+uint8_t SerialTransport::dict_check(UAVDatatypeHash datatype) {
+    // fold the hash down to a nibble
+    uint32_t h = (uint32_t)(datatype ^ (datatype>>32));
+    h ^= h>>16; h ^= h>>8; h ^= h>>4;
+    return h & 0x0F;
+}
+
+int SerialTransport::encode_compact(uint8_t* buffer, UAVTransfer* transfer) {
+    // find the datatype in our dictionary, defining it if it's new or due a refresh
+    int slot;
+    for(slot=0; slot<_dict_tx_count; slot++) {
+        if(_dict_tx[slot]==transfer->datatype) break;
+    }
+    bool define = false;
+    if(slot==_dict_tx_count) {
+        // replace entries round robin once it's full
+        slot = _dict_tx_next;
+        _dict_tx_next = (_dict_tx_next+1) % UV_SERIAL_DICT_SIZE;
+        if(_dict_tx_count<UV_SERIAL_DICT_SIZE) _dict_tx_count++;
+        _dict_tx[slot] = transfer->datatype;
+        _dict_tx_uses[slot] = 0;
+        define = true;
+    } else if(++_dict_tx_uses[slot] >= UV_SERIAL_DICT_REFRESH) {
+        _dict_tx_uses[slot] = 0;
+        define = true;
+    }
+    // flags
+    uint8_t flags = transfer->priority & UV_SERIAL_COMPACT_PRIORITY;
+    uint16_t port_id = transfer->port_id;
+    switch(transfer->transfer_kind) {
+        case UAVTransfer::KindRequest: flags |= 1<<UV_SERIAL_COMPACT_KIND_SHIFT; port_id &= 0x3FFF; break;
+        case UAVTransfer::KindResponse: flags |= 2<<UV_SERIAL_COMPACT_KIND_SHIFT; port_id &= 0x3FFF; break;
+    }
+    if(define) flags |= UV_SERIAL_COMPACT_DEFINE;
+    if(transfer->remote_node_id!=0xFFFF) flags |= UV_SERIAL_COMPACT_DESTINATION;
+    // build the header
+    int i = 0;
+    buffer[i++] = UV_SERIAL_FRAME_VERSION_1;
+    buffer[i++] = flags;
+    i += encode_varint(&buffer[i], transfer->local_node_id);
+    if(flags & UV_SERIAL_COMPACT_DESTINATION) i += encode_varint(&buffer[i], transfer->remote_node_id);
+    i += encode_varint(&buffer[i], port_id);
+    i += encode_varint(&buffer[i], transfer->transfer_id);
+    buffer[i++] = slot | (dict_check(transfer->datatype)<<4);
+    if(define) {
+        UAVTransport::encode_uint64(&buffer[i], transfer->datatype);
+        i += 8;
+    }
+    // one crc covers the header and payload, and goes after the header here
+    uint32_t crc = crc32c_update(CRC32C_INITIAL, buffer, i);
+    crc = crc32c_update(crc, transfer->payload, transfer->payload_size);
+    UAVTransport::encode_uint32(&buffer[i], crc ^ 0xFFFFFFFF);
+    return i;
+}
+
+int SerialTransport::encode_hello(uint8_t* buffer, UAVNodeID node_id) {
+    // version, flags and our node id, under the usual crc
+    int i = 0;
+    buffer[i++] = UV_SERIAL_FRAME_VERSION_1;
+    buffer[i++] = UV_SERIAL_COMPACT_HELLO << UV_SERIAL_COMPACT_KIND_SHIFT;
+    i += encode_varint(&buffer[i], node_id);
+    UAVTransport::encode_uint32(&buffer[i], crc32c(buffer, i));
+    return i + UV_SERIAL_CRC_SIZE;
+}
+
+uint8_t* SerialTransport::tx_segment(int index, int* length) {
+    if(_tx_compact_size==0) return frame_segment(_tx->transfer, index, length);
+    // compact header, payload, then trailer
+    UAVTransfer* transfer = _tx->transfer;
+    if(index < _tx_compact_size) {
+        *length = _tx_compact_size - index;
+        return &_tx_compact[index];
+    }
+    index -= _tx_compact_size;
+    if(index < (int)transfer->payload_size) {
+        *length = transfer->payload_size - index;
+        return &transfer->payload[index];
+    }
+    index -= transfer->payload_size;
+    *length = UV_SERIAL_CRC_SIZE - index;
+    return &_tx_compact[_tx_compact_size + index];
+}
+
+bool SerialTransport::decode_compact(uint8_t* buffer, int size, uint32_t crc, UAVNode* node) {
+    // one crc covers everything, so nothing can be trusted until it checks out
+    if( (size < UV_SERIAL_COMPACT_MIN_FRAME_SIZE) || (crc != CRC32C_RESIDUE) ) {
+        if(crc != CRC32C_RESIDUE) crc_errors++;
+        frames_rejected++;
+        return false;
+    }
+    int end = size - UV_SERIAL_CRC_SIZE;
+    uint8_t flags = buffer[1];
+    int i = 2;
+    int n;
+    uint64_t src_node_id, dst_node_id = 0xFFFF, port_id, transfer_id;
+    if( (n = decode_varint(&buffer[i], end-i, &src_node_id)) == 0 ) return false;
+    i += n;
+    peer_heard(src_node_id);
+    // a peer that sends them can take them, and needs no more hellos
+    _peer_compact = true;
+    _hello_tries = 0;
+    // a hello carries nothing more
+    if( ((flags>>UV_SERIAL_COMPACT_KIND_SHIFT) & 3) == UV_SERIAL_COMPACT_HELLO ) return true;
+    _peer_sends_compact = true;
+    if(flags & UV_SERIAL_COMPACT_DESTINATION) {
+        if( (n = decode_varint(&buffer[i], end-i, &dst_node_id)) == 0 ) return false;
+        i += n;
+    }
+    if( (n = decode_varint(&buffer[i], end-i, &port_id)) == 0 ) return false;
+    i += n;
+    if( (n = decode_varint(&buffer[i], end-i, &transfer_id)) == 0 ) return false;
+    i += n;
+    // is it addressed to us, or everyone?
+    if( !promiscuous && (dst_node_id != 0xFFFF) && (dst_node_id != node->local_node_id) ) {
+        frames_rejected++;
+        return false;
+    }
+    rx_frames++;
+    UAVTransferKind kind = UAVTransfer::KindMessage;
+    switch( (flags>>UV_SERIAL_COMPACT_KIND_SHIFT) & 3 ) {
+        case 1: kind = UAVTransfer::KindRequest; port_id = (port_id & 0x3FFF) | 0x8000; break;
+        case 2: kind = UAVTransfer::KindResponse; port_id = (port_id & 0x3FFF) | 0x8000; break;
+    }
+    // the datatype comes from the sender's dictionary, which it may be defining now
+    if(i >= end) return false;
+    uint8_t dict = buffer[i++];
+    uint8_t index = dict & (UV_SERIAL_DICT_SIZE-1);
+    SerialDictEntry* entry = nullptr;
+    for(int e=0; e<UV_SERIAL_DICT_RX_SIZE; e++) {
+        if( _dict_rx[e].used && (_dict_rx[e].src_node_id==src_node_id) && (_dict_rx[e].index==index) ) {
+            entry = &_dict_rx[e];
+            break;
+        }
+    }
+    if(flags & UV_SERIAL_COMPACT_DEFINE) {
+        if(i+8 > end) return false;
+        if(entry==nullptr) {
+            entry = &_dict_rx[_dict_rx_next];
+            _dict_rx_next = (_dict_rx_next+1) % UV_SERIAL_DICT_RX_SIZE;
+            entry->used = true;
+            entry->src_node_id = src_node_id;
+            entry->index = index;
+        }
+        entry->datatype = UAVTransport::decode_uint64(&buffer[i]);
+        i += 8;
+    }
+    // unknown, or the sender has since reused the entry for something else
+    if( (entry==nullptr) || (dict_check(entry->datatype) != (dict>>4)) ) {
+        dict_misses++;
+        return false;
+    }
+    UAVTransfer transfer;
+    transfer.timestamp_usec = 0;
+    transfer.priority = flags & UV_SERIAL_COMPACT_PRIORITY;
+    transfer.transfer_kind = kind;
+    transfer.port_id = port_id;
+    transfer.datatype = entry->datatype;
+    transfer.local_node_id = dst_node_id;
+    transfer.remote_node_id = src_node_id;
+    transfer.transfer_id = transfer_id;
+    transfer.payload_size = end - i;
+    transfer.payload = &buffer[i];
+    node->transfer_receive(&transfer);
+    return true;
+}
+
+int SerialTransport::encode_varint(uint8_t* buffer, uint64_t value) {
+    int i = 0;
+    while(value >= 0x80) {
+        buffer[i++] = (value & 0x7F) | 0x80;
+        value >>= 7;
+    }
+    buffer[i++] = value;
+    return i;
+}
+
+int SerialTransport::decode_varint(const uint8_t* buffer, int size, uint64_t* value) {
+    uint64_t v = 0;
+    for(int i=0; (i<size) && (i<10); i++) {
+        v |= (uint64_t)(buffer[i] & 0x7F) << (i*7);
+        if((buffer[i] & 0x80)==0) {
+            *value = v;
+            return i+1;
+        }
+    }
+    return 0;
+}
+
+bool SerialTransport::reassemble(UAVNode* node, UAVTransfer& frame, uint32_t frame_index) {
+    uint32_t index = frame_index & ~UV_SERIAL_FRAME_EOT;
+    uint32_t now = _now;
+    // find the session for this (source, port, transfer id)
+    SerialSession* session = nullptr;
+    for(int i=0; i<UV_SERIAL_MAX_SESSIONS; i++) {
+        SerialSession* s = &_sessions[i];
+        if( s->active && (s->src_node_id==frame.remote_node_id) && (s->port_id==frame.port_id) && (s->transfer_id==frame.transfer_id) ) {
+            session = s;
+            break;
+        }
+    }
+    if(session==nullptr) {
+        // a transfer has to start at the first frame, anything else is the tail of one we lost
+        if(index!=0) {
+            node->transfer_error(frame.port_id, frame.datatype);
+            return false;
+        }
+        session = session_start(node, frame, now);
+    } else if(index!=session->next_index) {
+        // a frame went missing, the transfer can't be completed
+        session_end(session);
+        node->transfer_error(frame.port_id, frame.datatype);
+        return false;
+    }
+    // will it still fit?
+    int size = session->size + frame.payload_size;
+    if(size > max_transfer_size) {
+        session_end(session);
+        node->transfer_error(frame.port_id, frame.datatype);
+        return false;
+    }
+    // grow the buffer in doubling steps, up to the transfer limit
+    if(size > session->capacity) {
+        int capacity = max(session->capacity*2, UV_SERIAL_MAX_FRAME_SIZE);
+        while(capacity < size) capacity *= 2;
+        capacity = min(capacity, max_transfer_size);
+        uint8_t* buffer = new uint8_t[capacity];
+        if(session->buffer!=nullptr) {
+            memcpy(buffer, session->buffer, session->size);
+            delete[] session->buffer;
+        }
+        session->buffer = buffer;
+        session->capacity = capacity;
+    }
+    memcpy(&session->buffer[session->size], frame.payload, frame.payload_size);
+    session->size = size;
+    session->next_index++;
+    session->updated = now;
+    // was that the last one?
+    if((frame_index & UV_SERIAL_FRAME_EOT)==0) return true;
+    // hand the whole transfer to the node
+    UAVTransfer transfer;
+    transfer.timestamp_usec = 0;
+    transfer.priority = session->priority;
+    transfer.transfer_kind = session->kind;
+    transfer.port_id = session->port_id;
+    transfer.datatype = session->datatype;
+    transfer.local_node_id = session->dst_node_id;
+    transfer.remote_node_id = session->src_node_id;
+    transfer.transfer_id = session->transfer_id;
+    transfer.payload_size = session->size;
+    transfer.payload = session->buffer;
+    node->transfer_receive(&transfer);
+    session_end(session);
+    return true;
+}
+
+SerialSession* SerialTransport::session_start(UAVNode* node, UAVTransfer& frame, uint32_t now) {
+    // take a free session, or evict the one that has waited longest for its next frame
+    SerialSession* session = nullptr;
+    for(int i=0; i<UV_SERIAL_MAX_SESSIONS; i++) {
+        SerialSession* s = &_sessions[i];
+        if(!s->active) {
+            session = s;
+            break;
+        }
+        if( (session==nullptr) || ((int32_t)(s->updated - session->updated) < 0) ) session = s;
+    }
+    if(session->active) {
+        session_evictions++;
+        node->transfer_error(session->port_id, session->datatype);
+        session_end(session);
+    }
+    session->active = true;
+    session->src_node_id = frame.remote_node_id;
+    session->dst_node_id = frame.local_node_id;
+    session->port_id = frame.port_id;
+    session->kind = frame.transfer_kind;
+    session->priority = frame.priority;
+    session->datatype = frame.datatype;
+    session->transfer_id = frame.transfer_id;
+    session->next_index = 0;
+    session->updated = now;
+    session->size = 0;
+    session->capacity = 0;
+    session->buffer = nullptr;
+    return session;
+}
+
+void SerialTransport::session_end(SerialSession* session) {
+    delete[] session->buffer;
+    session->buffer = nullptr;
+    session->active = false;
+}
+
+void SerialTransport::session_expire(UAVNode* node, uint32_t now) {
+    for(int i=0; i<UV_SERIAL_MAX_SESSIONS; i++) {
+        SerialSession* s = &_sessions[i];
+        if( s->active && ((uint32_t)(now - s->updated) > session_timeout) ) {
+            session_timeouts++;
+            node->transfer_error(s->port_id, s->datatype);
+            session_end(s);
+        }
+    }
+}
+
+UAVSendStatus SerialTransport::send(UAVTransfer* transfer) {
     // has the serial frame been encoded?
     if(transfer->frame_data==nullptr) {
         // do it now and share between all serial transports
         SerialTransport::encode_frame(transfer);
     }
-    // the transfer is ready to go. wrap it in a SerialFrame
-    SerialFrame *frame = new SerialFrame();
-    frame->transfer = transfer;
-    frame->transfer_state = UV_SERIAL_RX_STATE_NONE;
-    frame->frame_size = transfer->frame_size;
-    frame->frame_index = 0;
-    frame->frame_buffer = transfer->frame_data;
-    // insert it into the transfer queue
+    // queue it by priority
+    int priority = transfer->priority & (UV_SERIAL_PRIORITIES-1);
+    UAVTransfer* victim = nullptr;
+    if(_queue_free<0) {
+        // every entry is taken. only drop-oldest makes room, from the least urgent waiting transfer, if it is no more urgent than the new one.
+        int lowest = 31 - __builtin_clz(_queued);
+        if( (drop_policy==UV_SERIAL_DROP_OLDEST) && (lowest >= priority) ) {
+            drops[lowest]++;
+            victim = queue_pop(lowest);
+        } else {
+            // the others leave the queue alone and refuse the new one
+            drops[priority]++;
+            _blocked |= (1<<priority);
+            transfer->dropped();
+            return (drop_policy==UV_SERIAL_REJECT) ? UV_SEND_REJECTED : UV_SEND_DROPPED;
+        }
+    }
+    // the queue keeps a reference until the transfer has been written
     transfer->ref();
-    _queue->insert(transfer->priority, frame);
-    // if the queue is now full...
-    if(_queue->count==_queue->size) {
-        // remove the message with the least priority
-        dequeue(_queue->count-1);
-    }
-}
-
-void SerialTransport::dequeue(int index) {
-    // find that entry
-    SerialFrame *frame = (SerialFrame *)_queue->values[index];
-    if(frame==NULL) return;
-    // remove the entry from the queue
-    _queue->remove_index(index);
-    // destroy the frame state container, but keep the transfer
-    UAVTransfer* transfer = frame->transfer;
-    delete frame;
-    // decrement the transfer usage, this may complete the transfer
-    transfer->unref();
+    queue_push(priority, transfer);
+    // let the victim go last, since its completion hook may send again
+    if(victim!=nullptr) {
+        victim->dropped();
+        victim->unref();
+    }
+    return UV_SEND_QUEUED;
+}
+bool SerialTransport::writable(UAVPriority priority) {
+    if(_queue_free>=0) return true;
+    // full. remember to say when it isn't
+    _blocked |= (1 << (priority & (UV_SERIAL_PRIORITIES-1)));
+    return false;
+}
+void SerialTransport::queue_push(int priority, UAVTransfer* transfer) {
+    // take a free entry and link it on the tail
+    int16_t index = _queue_free;
+    SerialQueueEntry* entry = &_queue_entries[index];
+    _queue_free = entry->next;
+    entry->transfer = transfer;
+    entry->next = -1;
+    SerialQueue* queue = &_queues[priority];
+    if(queue->count==0) queue->head = index; else _queue_entries[queue->tail].next = index;
+    queue->tail = index;
+    queue->count++;
+    _queued |= (1<<priority);
+}
+UAVTransfer* SerialTransport::queue_pop(int priority) {
+    // unlink the head and put it back on the free list
+    SerialQueue* queue = &_queues[priority];
+    int16_t index = queue->head;
+    SerialQueueEntry* entry = &_queue_entries[index];
+    queue->head = entry->next;
+    if(--queue->count==0) _queued &= ~(1<<priority);
+    entry->next = _queue_free;
+    _queue_free = index;
+    return entry->transfer;
+}
+UAVTransfer* SerialTransport::dequeue() {
+    if(_queued==0) return nullptr;
+    // lowest set bit is the most urgent priority
+    return queue_pop(__builtin_ctz(_queued));
 }
 
@@ -5,8 +5,10 @@
 #include "../node.h"
 #include "../transport.h"
 #include "../numbermap.h"
+#include <atomic>
 
 #define UV_SERIAL_FRAME_VERSION_0   0x00
+#define UV_SERIAL_FRAME_VERSION_1   0x01
 #define UV_SERIAL_FRAME_DELIMITER   0x9E
 #define UV_SERIAL_ESCAPE_PREFIX     0x8E
 #define UV_SERIAL_NODEID_MASK       0x0FFF
@@ -17,15 +19,104 @@
 #define UV_SERIAL_RX_STATE_DELIMITER 2
 #define UV_SERIAL_RX_STATE_FRAME     3
 #define UV_SERIAL_RX_STATE_ESCAPE    4
+#define UV_SERIAL_RX_STATE_SKIP      5
 
 #define UV_SERIAL_MAX_FRAME_SIZE           1024
 #define UV_SERIAL_CRC_SIZE                 4
 #define UV_SERIAL_HEADER_WITHOUT_CRC_SIZE  28
 #define UV_SERIAL_HEADER_WITH_CRC_SIZE     (UV_SERIAL_HEADER_WITHOUT_CRC_SIZE + UV_SERIAL_CRC_SIZE)
 #define UV_SERIAL_MIN_FRAME_SIZE           (UV_SERIAL_HEADER_WITH_CRC_SIZE + UV_SERIAL_CRC_SIZE)
+#define UV_SERIAL_MAX_PAYLOAD_SIZE         (UV_SERIAL_MAX_FRAME_SIZE - UV_SERIAL_MIN_FRAME_SIZE)
+#define UV_SERIAL_FRAME_EOT                ((uint32_t)1<<31)
+
+// compact (version 1) frames, for single frame transfers on slow links:
+//   version, flags, varint source, [varint destination], varint port, varint transfer id,
+//   datatype dictionary byte, [8 byte datatype hash], payload, crc of the whole frame
+#define UV_SERIAL_COMPACT_PRIORITY         0x07
+#define UV_SERIAL_COMPACT_KIND_SHIFT       3
+#define UV_SERIAL_COMPACT_DEFINE           0x20    // the datatype hash follows the dictionary byte
+#define UV_SERIAL_COMPACT_DESTINATION      0x40    // a destination node id is present, otherwise it's a broadcast
+#define UV_SERIAL_COMPACT_MAX_HEADER       32
+#define UV_SERIAL_COMPACT_MIN_FRAME_SIZE   (3 + UV_SERIAL_CRC_SIZE)
+// a compact frame of this kind carries no transfer. it only says the sender can decode compact frames. old receivers drop it, as they do all version 1 frames.
+#define UV_SERIAL_COMPACT_HELLO            3
+#define UV_SERIAL_HELLO_SIZE               (2 + 3 + UV_SERIAL_CRC_SIZE)
+#ifndef UV_SERIAL_HELLO_INTERVAL
+#define UV_SERIAL_HELLO_INTERVAL           1000    // ms before the second hello to a peer that still sends version 0, doubling after each
+#endif
+#ifndef UV_SERIAL_HELLO_TRIES
+#define UV_SERIAL_HELLO_TRIES              4       // hellos that go unanswered before giving up on a peer
+#endif
+#ifndef UV_SERIAL_PEER_TIMEOUT
+#define UV_SERIAL_PEER_TIMEOUT             10000   // ms without a change of sender before a shared link counts as point-to-point again
+#endif
+// when to send compact frames
+#define UV_SERIAL_COMPACT_OFF              0
+#define UV_SERIAL_COMPACT_AUTO             1       // once the peer has said it understands them, on point-to-point links
+#define UV_SERIAL_COMPACT_ON               2
+// datatype dictionary. the dictionary byte is a 4 bit index and a 4 bit check of the hash, so stale entries are caught.
+// each entry is defined again every so many uses, in case the defining frame was lost.
+#define UV_SERIAL_DICT_SIZE                16
+#ifndef UV_SERIAL_DICT_REFRESH
+#define UV_SERIAL_DICT_REFRESH             16
+#endif
+#ifndef UV_SERIAL_DICT_RX_SIZE
+#define UV_SERIAL_DICT_RX_SIZE             32
+#endif
+
+// multi-frame reassembly. concurrent transfers being received, how long to wait for the next frame, and the largest transfer accepted
+#ifndef UV_SERIAL_MAX_SESSIONS
+#define UV_SERIAL_MAX_SESSIONS             4
+#endif
+#ifndef UV_SERIAL_SESSION_TIMEOUT
+#define UV_SERIAL_SESSION_TIMEOUT          1000
+#endif
+#ifndef UV_SERIAL_MAX_TRANSFER_SIZE
+#define UV_SERIAL_MAX_TRANSFER_SIZE        65536
+#endif
 
 #define UV_SERIAL_DEBUG_LINE 16
 
+// default loopback and thread link ring size, rounded up to a power of two
+#ifndef UV_SERIAL_LOOPBACK_SIZE
+#define UV_SERIAL_LOOPBACK_SIZE 128
+#endif
+
+// receive frame buffer, which is also the largest frame accepted, and the block read from or written to the port at a time.
+// frames that arrive whole and unescaped within one read are decoded where they are, without touching the frame buffer.
+#ifndef UV_SERIAL_RX_BUFFER_SIZE
+#define UV_SERIAL_RX_BUFFER_SIZE UV_SERIAL_MAX_FRAME_SIZE
+#endif
+// linux and mac gateways have the memory to move much more per loop, to keep up with usb serial adapters.
+#if defined(__linux__) || defined(__APPLE__)
+#define UV_SERIAL_HOST_SCALE 16
+#else
+#define UV_SERIAL_HOST_SCALE 1
+#endif
+#ifndef UV_SERIAL_IO_BUFFER_SIZE
+#define UV_SERIAL_IO_BUFFER_SIZE (256 * UV_SERIAL_HOST_SCALE)
+#endif
+// bytes read and written per loop, and microseconds the loop may spend (0 for no time limit), so a busy link can't starve the rest of the node
+#ifndef UV_SERIAL_READ_BUDGET
+#define UV_SERIAL_READ_BUDGET (1024 * UV_SERIAL_HOST_SCALE)
+#endif
+#ifndef UV_SERIAL_WRITE_BUDGET
+#define UV_SERIAL_WRITE_BUDGET (1024 * UV_SERIAL_HOST_SCALE)
+#endif
+#ifndef UV_SERIAL_TIME_BUDGET
+#define UV_SERIAL_TIME_BUDGET 0
+#endif
+
+// transmit queues, one FIFO per priority level, sharing this many entries between them
+#ifndef UV_SERIAL_QUEUE_DEPTH
+#define UV_SERIAL_QUEUE_DEPTH 32
+#endif
+#define UV_SERIAL_PRIORITIES  8
+// what send() does when every entry is taken
+#define UV_SERIAL_DROP_OLDEST 0     // drop the oldest transfer of the least urgent priority, if that's no more urgent than the new one
+#define UV_SERIAL_DROP_NEWEST 1     // drop the new transfer
+#define UV_SERIAL_REJECT      2     // refuse the new transfer, and call on_writable once there is room
+
 
 class HardwareSerialPort : public UAVSerialPort {
     protected:
@@ -40,15 +131,33 @@ class HardwareSerialPort : public UAVSerialPort {
         int writeCount() override;
 };
 
+/*
+    Byte ring with a power-of-two size, read and written in at most two memcpy segments.
+    Only the writer moves the head and only the reader moves the tail, so one thread can write while another reads.
+*/
+class SerialRing {
+    protected:
+        uint8_t*                _buffer;
+        uint32_t                _mask;
+        std::atomic<uint32_t>   _head;      // bytes ever written
+        std::atomic<uint32_t>   _tail;      // bytes ever read
+    public:
+        SerialRing(int size);
+        ~SerialRing();
+        int size() { return _mask + 1; }
+        // both return how many bytes were actually moved
+        int read(uint8_t *buffer, int count);
+        int write(const uint8_t *buffer, int count);
+        int readCount();
+        int writeCount();
+};
+
 class LoopbackSerialPort : public UAVSerialPort {
     protected:
-        uint8_t _buffer[128];
-        int _size=128;
-        int _head=0;
-        int _tail=0;
-        int _count=0;
+        SerialRing _ring;
     public:
-        LoopbackSerialPort();
+        uint32_t overruns = 0;      // bytes written while the ring was full, and lost
+        LoopbackSerialPort(int size = UV_SERIAL_LOOPBACK_SIZE);
         ~LoopbackSerialPort();
         void read(uint8_t *buffer, int count) override;
         void write(uint8_t *buffer, int count) override;
@@ -57,6 +166,32 @@ class LoopbackSerialPort : public UAVSerialPort {
         int writeCount() override;
 };
 
+// one end of a link between transports running on different threads. what one end writes, the other reads.
+class SPSCSerialPort : public UAVSerialPort {
+    protected:
+        SerialRing* _rx;
+        SerialRing* _tx;
+    public:
+        uint32_t overruns = 0;      // bytes written while the other end was full, and lost
+        SPSCSerialPort(SerialRing* rx, SerialRing* tx);
+        ~SPSCSerialPort();
+        void read(uint8_t *buffer, int count) override;
+        void write(uint8_t *buffer, int count) override;
+        void flush() override;
+        int readCount() override;
+        int writeCount() override;
+};
+
+// the two rings of a thread link and the port at each end, eg. SerialTransport(link.a) on one thread and SerialTransport(link.b) on another
+class SPSCSerialLink {
+    protected:
+        SerialRing      _ab;
+        SerialRing      _ba;
+    public:
+        SPSCSerialPort  a;
+        SPSCSerialPort  b;
+        SPSCSerialLink(int size = UV_SERIAL_LOOPBACK_SIZE);
+};
 
 class DebugSerialPort : public UAVSerialPort {
     protected:
@@ -86,9 +221,49 @@ typedef struct {
     int             transfer_state;
     int             frame_size;
     int             frame_index;
+    int             frame_stride;   // size of each frame in a multi-frame buffer, 0 for a single frame
     uint8_t*        frame_buffer;
+    uint32_t        crc;            // running crc of the header or payload being received
 } SerialFrame;
 
+// transfers waiting to be sent at one priority, linked through the transport's queue entries
+typedef struct {
+    int16_t         head;           // the oldest entry, -1 when empty
+    int16_t         tail;           // the newest entry
+    int             count;
+} SerialQueue;
+
+// a queue entry, either on a priority's queue or on the free list
+typedef struct {
+    UAVTransfer*    transfer;
+    int16_t         next;
+} SerialQueueEntry;
+
+// a multi-frame transfer being reassembled
+typedef struct {
+    bool            active;
+    UAVNodeID       src_node_id;
+    UAVNodeID       dst_node_id;
+    UAVPortID       port_id;
+    UAVTransferKind kind;
+    UAVPriority     priority;
+    UAVDatatypeHash datatype;
+    UAVTransferID   transfer_id;
+    uint32_t        next_index;     // frame index we expect next
+    uint32_t        updated;        // loop time when the last frame arrived
+    int             size;
+    int             capacity;
+    uint8_t*        buffer;
+} SerialSession;
+
+// a datatype hash a peer defined in its dictionary
+typedef struct {
+    bool            used;
+    UAVNodeID       src_node_id;
+    uint8_t         index;
+    UAVDatatypeHash datatype;
+} SerialDictEntry;
+
 using SerialOOBHandler = void (*) (UAVTransport *transport, SerialFrame* rx, uint8_t* buffer, int count);
 
 // concrete serial transport
@@ -97,25 +272,108 @@ class SerialTransport : public UAVSerialTransport {
         UAVSerialPort*  _port;
         bool            _owner;
         SerialFrame*    _rx;
-        SerialFrame*    _tx;
-        NumberMap  *    _queue;
+        SerialFrame*    _tx;            // points at _tx_frame while a transfer is being written
+        SerialFrame     _tx_frame;
+        uint8_t*        _io_buffer;     // port reads and writes
+        int write_frames(uint8_t* buf, int remain, bool& sent);
+        // compact framing. the header and trailer of the compact frame being written, and the header length (0 when writing version 0)
+        bool            _peer_compact = false;
+        bool            _peer_sends_compact = false;    // it sent transfers in compact frames, not just hellos
+        UAVNodeID       _peer = 0xFFFF;         // the last node heard, and whether another was heard lately
+        bool            _peer_shared = false;
+        uint32_t        _peer_changed = 0;
+        void peer_heard(UAVNodeID src_node_id);
+        // a hello to send between transfers, once a peer is heard sending version 0, and how many have gone unanswered
+        bool            _hello_due = false;
+        uint8_t         _hello_tries = 0;
+        uint32_t        _hello_time = 0;
+        uint8_t         _hello[UV_SERIAL_HELLO_SIZE];
+        int             _hello_size = 0;
+        static int encode_hello(uint8_t* buffer, UAVNodeID node_id);
+        uint8_t         _tx_compact[UV_SERIAL_COMPACT_MAX_HEADER + UV_SERIAL_CRC_SIZE];
+        int             _tx_compact_size = 0;
+        UAVDatatypeHash _dict_tx[UV_SERIAL_DICT_SIZE];
+        uint8_t         _dict_tx_uses[UV_SERIAL_DICT_SIZE];
+        int             _dict_tx_count = 0;
+        int             _dict_tx_next = 0;
+        SerialDictEntry _dict_rx[UV_SERIAL_DICT_RX_SIZE];
+        int             _dict_rx_next = 0;
+        bool use_compact(UAVTransfer* transfer);
+        int encode_compact(uint8_t* buffer, UAVTransfer* transfer);
+        bool decode_compact(uint8_t* buffer, int size, uint32_t crc, UAVNode* node);
+        uint8_t* tx_segment(int index, int* length);
+        static uint8_t dict_check(UAVDatatypeHash datatype);
+        // transmit queues, and a bit for each priority that has something waiting
+        SerialQueue     _queues[UV_SERIAL_PRIORITIES];
+        SerialQueueEntry* _queue_entries;
+        int             _queue_depth;
+        int16_t         _queue_free;    // first free entry, -1 when all are taken
+        uint8_t         _queued;
+        uint8_t         _blocked;       // priorities that were found full, and owe an on_writable call
+        void queue_push(int priority, UAVTransfer* transfer);
+        UAVTransfer* queue_pop(int priority);
+        // multi-frame reassembly. sessions are stamped and expired on the time of the last loop, whatever clock it runs on.
+        SerialSession   _sessions[UV_SERIAL_MAX_SESSIONS];
+        uint32_t        _now = 0;
+        bool reassemble(UAVNode* node, UAVTransfer& frame, uint32_t frame_index);
+        SerialSession* session_start(UAVNode* node, UAVTransfer& frame, uint32_t now);
+        void session_end(SerialSession* session);
+        void session_expire(UAVNode* node, uint32_t now);
+        static void encode_header(uint8_t* buffer, UAVTransfer* transfer, uint32_t frame_index);
+        bool header_accept(uint8_t* header, uint32_t crc, UAVNode* node);
     public:
+        // reassembly limits and counters
+        uint32_t        session_timeout = UV_SERIAL_SESSION_TIMEOUT;
+        int             max_transfer_size = UV_SERIAL_MAX_TRANSFER_SIZE;
+        uint32_t        session_evictions = 0;
+        uint32_t        session_timeouts = 0;
+        // frames dropped by the receiver before they were buffered - bad header crc, not for us, or too big
+        uint32_t        frames_rejected = 0;
+        // frames that checked out and were for us, frames that failed a crc, and bytes seen outside any frame
+        uint32_t        rx_frames = 0;
+        uint32_t        crc_errors = 0;
+        uint64_t        oob_bytes = 0;
+        // accept frames addressed to any node, eg. for bus monitors
+        bool            promiscuous = false;
+        // compact frame mode, compact frames dropped because their datatype wasn't in the dictionary, and hellos sent
+        int             compact = UV_SERIAL_COMPACT_AUTO;
+        uint32_t        dict_misses = 0;
+        uint32_t        hellos = 0;
+        // per loop i/o limits, and bytes moved
+        int             read_budget = UV_SERIAL_READ_BUDGET;
+        int             write_budget = UV_SERIAL_WRITE_BUDGET;
+        uint32_t        time_budget = UV_SERIAL_TIME_BUDGET;
+        uint64_t        rx_bytes = 0;
+        uint64_t        tx_bytes = 0;
+        // full transmit queue handling, and the transfers dropped at each priority
+        int             drop_policy = UV_SERIAL_DROP_OLDEST;
+        uint32_t        drops[UV_SERIAL_PRIORITIES] = { 0 };
         // out-of-band handler
         SerialOOBHandler oob_handler = nullptr;
         // con/destructors
-        SerialTransport(UAVSerialPort* port, bool owner, SerialOOBHandler oob);
+        SerialTransport(UAVSerialPort* port, bool owner, SerialOOBHandler oob, int queue_depth = UV_SERIAL_QUEUE_DEPTH, int rx_buffer_size = UV_SERIAL_RX_BUFFER_SIZE);
         SerialTransport(UAVSerialPort* port) : SerialTransport{port,true,nullptr} {};
         SerialTransport(UAVSerialPort& port) : SerialTransport{&port,false,nullptr} {};
         virtual ~SerialTransport();
         // serial transport methods
         void loop(UAVNode& node, const unsigned long t, const int dt) override;
-        void send(UAVTransfer* transfer) override;
+        UAVSendStatus send(UAVTransfer* transfer) override;
+        bool writable(UAVPriority priority) override;
         // frame encoding and decoding
         static void encode_frame(UAVTransfer* transfer);
-        static bool decode_frame(SerialFrame* rx, UAVNode *node);
+        // find a byte of an encoded transfer in its header, payload or trailer, and how many bytes follow it there
+        static uint8_t* frame_segment(UAVTransfer* transfer, int index, int* length);
+        bool decode_frame(uint8_t* buffer, int size, uint32_t crc, UAVNode *node);
+        void decode_direct(uint8_t* frame, int size, UAVNode* node);
         void parse_buffer(uint8_t* parse, int count, UAVNode* node);
-        // transmit queue management
-        void dequeue(int index);
+        // length of the leading run of bytes that need no escaping, ie. up to the first delimiter or escape prefix
+        static int clean_run(const uint8_t* data, int size);
+        // little-endian base 128 integers. decode returns the bytes used, or 0 if it ran off the end.
+        static int encode_varint(uint8_t* buffer, uint64_t value);
+        static int decode_varint(const uint8_t* buffer, int size, uint64_t* value);
+        // transmit queue management. dequeue takes the oldest transfer of the highest waiting priority, passing on its reference.
+        UAVTransfer* dequeue();
+        int queued(int priority) { return _queues[priority & (UV_SERIAL_PRIORITIES-1)].count; }
 };
 
 
@@ -0,0 +1,100 @@
+#include "simbus.h"
+
+// simulated bus endpoint
+
+SimulatedSerialPort::SimulatedSerialPort(int size) : _rx(size), _tx(size) { }
+SimulatedSerialPort::~SimulatedSerialPort() { }
+void SimulatedSerialPort::read(uint8_t *buffer, int count) {
+    _rx.read(buffer, count);
+}
+void SimulatedSerialPort::write(uint8_t *buffer, int count) {
+    overruns += count - _tx.write(buffer, count);
+}
+void SimulatedSerialPort::flush() { }
+int SimulatedSerialPort::readCount() {
+    return _rx.readCount();
+}
+int SimulatedSerialPort::writeCount() {
+    return _tx.writeCount();
+}
+
+// simulated bus
+
+SimulatedSerialBus::SimulatedSerialBus(uint32_t baud, uint32_t latency_us, uint32_t error_ppm, int buffer_size, uint32_t seed) {
+    this->baud = baud;
+    this->latency_us = latency_us;
+    this->error_ppm = error_ppm;
+    this->buffer_size = buffer_size;
+    _random = seed ? seed : 1;
+}
+
+SimulatedSerialBus::~SimulatedSerialBus() {
+    for(auto port : _ports) delete port;
+}
+
+SimulatedSerialPort* SimulatedSerialBus::connect() {
+    SimulatedSerialPort* port = new SimulatedSerialPort(buffer_size);
+    _ports.push_back(port);
+    return port;
+}
+
+SimulatedSerialPort* SimulatedSerialBus::next_talker() {
+    int count = _ports.size();
+    for(int i=0; i<count; i++) {
+        SimulatedSerialPort* port = _ports[(_next + i) % count];
+        if(port->_tx.readCount()>0) {
+            _next = (_next + i + 1) % count;
+            return port;
+        }
+    }
+    return nullptr;
+}
+
+void SimulatedSerialBus::advance(uint32_t us) {
+    uint64_t end = (now_us + us) * 1000;
+    uint64_t byte_time = 10000000000ULL / baud;
+    uint64_t latency = (uint64_t)latency_us * 1000;
+    // the medium can't have got ahead of the clock while idle
+    if(_clock < now_us * 1000) _clock = now_us * 1000;
+    // one byte slot at a time
+    while(_clock + byte_time <= end) {
+        if(_talker==nullptr) {
+            _talker = next_talker();
+            _gap = 0;
+            // nobody has anything to say
+            if(_talker==nullptr) break;
+        }
+        uint8_t data;
+        if(_talker->_tx.read(&data, 1)==0) {
+            // quiet mid-frame. wait a while before letting someone else talk
+            _clock += byte_time;
+            if(++_gap >= UV_SIMBUS_HOLD_BYTES) _talker = nullptr;
+            continue;
+        }
+        _gap = 0;
+        _clock += byte_time;
+        _busy += byte_time;
+        bytes_carried++;
+        // delimiters never appear inside a frame, so the stream can be handed over after one without splitting a frame
+        SimulatedSerialPort* talker = _talker;
+        if(data==UV_SERIAL_FRAME_DELIMITER) _talker = nullptr;
+        // xorshift for reproducible bit errors
+        _random ^= _random << 13; _random ^= _random >> 17; _random ^= _random << 5;
+        if( (error_ppm>0) && ((_random % 1000000) < error_ppm) ) {
+            data ^= 1 << ((_random >> 20) & 7);
+            bytes_corrupted++;
+        }
+        _flight.push_back({ _clock + latency, talker, data });
+    }
+    // deliver what has arrived to everyone but the sender
+    while( !_flight.empty() && (_flight.front().arrive <= end) ) {
+        SimulatedSerialByte& b = _flight.front();
+        for(auto port : _ports) {
+            if(port==b.source) continue;
+            if(port->_rx.write(&b.data, 1)==0) port->rx_lost++;
+        }
+        _flight.pop_front();
+    }
+    now_us += us;
+    busy_us = _busy / 1000;
+}
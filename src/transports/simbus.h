@@ -0,0 +1,85 @@
+#ifndef LIBUAVESP_TRANSPORT_SIMBUS_H_INCLUDED
+#define LIBUAVESP_TRANSPORT_SIMBUS_H_INCLUDED
+
+#include "../common.h"
+#include "../transport.h"
+#include "serial.h"
+#include <vector>
+#include <deque>
+
+// receive and transmit buffer of each endpoint, rounded up to a power of two
+#ifndef UV_SIMBUS_BUFFER_SIZE
+#define UV_SIMBUS_BUFFER_SIZE 1024
+#endif
+// byte times a talker may pause mid-frame before another endpoint gets the bus
+#ifndef UV_SIMBUS_HOLD_BYTES
+#define UV_SIMBUS_HOLD_BYTES 16
+#endif
+
+class SimulatedSerialBus;
+
+// an endpoint on a simulated bus. reads what every other endpoint wrote, writes to all of them.
+class SimulatedSerialPort : public UAVSerialPort {
+    friend class SimulatedSerialBus;
+    protected:
+        SerialRing      _rx;
+        SerialRing      _tx;
+    public:
+        uint32_t        overruns = 0;       // bytes written while the transmit buffer was full
+        uint32_t        rx_lost = 0;        // bytes that arrived while the receive buffer was full
+        SimulatedSerialPort(int size);
+        ~SimulatedSerialPort();
+        void read(uint8_t *buffer, int count) override;
+        void write(uint8_t *buffer, int count) override;
+        void flush() override;
+        int readCount() override;
+        int writeCount() override;
+};
+
+// a byte on its way across the bus
+typedef struct {
+    uint64_t                arrive;         // simulated nanoseconds
+    SimulatedSerialPort*    source;
+    uint8_t                 data;
+} SimulatedSerialByte;
+
+/*
+    Shared serial medium for load testing many nodes in one process, in simulated time.
+    One endpoint talks at a time, a byte every 10 bit times at the baud rate. A talker keeps the bus until it sends a
+    frame delimiter or pauses too long, then it passes round robin to the next endpoint with something to say, so
+    frames from different endpoints interleave whole. Bytes arrive at every other endpoint after the latency, with random bit errors.
+    Nothing moves until advance() is called, so the caller drives the nodes and the clock, eg.
+        bus.advance(1000); node.loop(bus.millis(), 1);
+*/
+class SimulatedSerialBus {
+    protected:
+        std::vector<SimulatedSerialPort*> _ports;
+        std::deque<SimulatedSerialByte> _flight;
+        SimulatedSerialPort*    _talker = nullptr;
+        int                     _next = 0;      // where the round robin search starts
+        int                     _gap = 0;       // byte times the talker has been quiet
+        uint64_t                _clock = 0;     // nanoseconds, the medium's own time
+        uint64_t                _busy = 0;      // nanoseconds spent carrying bytes
+        uint32_t                _random;
+        SimulatedSerialPort* next_talker();
+    public:
+        // medium properties. errors are bit flips per million bytes.
+        uint32_t        baud;
+        uint32_t        latency_us;
+        uint32_t        error_ppm;
+        int             buffer_size;
+        // simulated time, and traffic counters
+        uint64_t        now_us = 0;
+        uint64_t        busy_us = 0;
+        uint64_t        bytes_carried = 0;
+        uint64_t        bytes_corrupted = 0;
+        SimulatedSerialBus(uint32_t baud = 115200, uint32_t latency_us = 0, uint32_t error_ppm = 0, int buffer_size = UV_SIMBUS_BUFFER_SIZE, uint32_t seed = 1);
+        ~SimulatedSerialBus();
+        // add an endpoint. the bus owns it, so wrap it with SerialTransport(*port).
+        SimulatedSerialPort* connect();
+        // run the medium forward
+        void advance(uint32_t us);
+        uint32_t millis() { return now_us / 1000; }
+};
+
+#endif
@@ -27,6 +27,8 @@ UDPTransport::UDPTransport(uint16_t message_port) {
     // create the common 'anonymous' port control for subject messages.
     _pcb = udp_new();
     _pcb->local_port = message_port;
+    // datagrams arrive through lwip callbacks, so there's nothing to poll for
+    period = 1000;
     // use the wifi object to reset our ip address properties
     reset_ip();
 }
@@ -101,18 +103,37 @@ ip_addr_t UDPTransport::node_addr(UAVNodeID node_id) {
 }
 #endif
 
-void UDPTransport::send(UAVTransfer* transfer) {
+UAVSendStatus UDPTransport::send(UAVTransfer* transfer) {
     // turn the destination node id into a udp/ip address
     ip_addr_t udp_addr = node_addr(transfer->remote_node_id);
+    return send_datagram(transfer, &udp_addr);
+}
+
+void UDPTransport::send_batch(UAVTransfer** transfers, int count) {
+    // one pass over the batch, only working out the destination address when it changes
+    UAVNodeID node_id = 0;
+    ip_addr_t udp_addr;
+    for(int i=0; i<count; i++) {
+        UAVTransfer* transfer = transfers[i];
+        if( (i==0) || (transfer->remote_node_id!=node_id) ) {
+            node_id = transfer->remote_node_id;
+            udp_addr = node_addr(node_id);
+        }
+        send_datagram(transfer, &udp_addr);
+    }
+}
+
+UAVSendStatus UDPTransport::send_datagram(UAVTransfer* transfer, ip_addr_t* udp_addr) {
     // turn the UAVCAN port id into a UDP port number
     uint16_t udp_port = udp_port_number(transfer->port_id, transfer->transfer_kind);
-    // build a single-frame datagram from the payload
+    // allocate a lwip buffer for the whole datagram. the payload is copied in rather than chained by reference,
+    // since the netif driver may hold on to the pbuf after udp_sendto() returns.
     int size = 24 + transfer->payload_size;
-    // allocate a lwip buffer for the datagram
     pbuf* tx_dgram = pbuf_alloc(PBUF_TRANSPORT, size, PBUF_RAM);
     if(!tx_dgram){
         Serial.print("failed pbuf_alloc");
-        return;
+        transfer->dropped();
+        return UV_SEND_DROPPED;
     }
     // wrap the lwip buffer in an output stream
     UAVOutStream s( reinterpret_cast<uint8_t*>(tx_dgram->payload), size);
@@ -127,12 +148,16 @@ void UDPTransport::send(UAVTransfer* transfer) {
     s.output_memcpy(transfer->payload, transfer->payload_size);
 
     // send the complete udp datagram
-    err_t err = udp_sendto(_pcb, tx_dgram, &udp_addr, udp_port);
+    err_t err = udp_sendto(_pcb, tx_dgram, udp_addr, udp_port);
+    // we are done with the buffer
+    pbuf_free(tx_dgram);
     if (err != ERR_OK) {
         Serial.print("udp_sendto err="); Serial.println((int) err);
+        transfer->dropped();
+        return UV_SEND_DROPPED;
     }
-    // we are done with the buffer
-    pbuf_free(tx_dgram);
+    transfer->sent();
+    return UV_SEND_SENT;
 }
 
 
@@ -23,6 +23,7 @@ class UDPTransport : public UAVTransport {
         // udp methods
         static void decode_frame(UAVNode& node, UAVNodeID src_node_id, UAVNodeID dst_node_id, uint16_t udp_port, UAVInStream& in);
         ip_addr_t node_addr(UAVNodeID node_id);
+        UAVSendStatus send_datagram(UAVTransfer* transfer, ip_addr_t* udp_addr);
     public:
         // constructor and destructor
         UDPTransport(uint16_t message_port);
@@ -37,7 +38,8 @@ class UDPTransport : public UAVTransport {
         bool start(UAVNode& node) override;
         bool stop(UAVNode& node) override;
         void loop(UAVNode& node, const unsigned long t, const int dt) { };
-        void send(UAVTransfer* transfer) override;
+        UAVSendStatus send(UAVTransfer* transfer) override;
+        void send_batch(UAVTransfer** transfers, int count) override;
 };
 
 /*